@@ -0,0 +1,102 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+// replaces the global operator new and delete so every allocation is counted, see memory.hpp.
+// this isn't part of compdb-vs-lib, it's compiled into the tests, and into compdb-vs with COMPDBVS_ALLOCATION_COUNTING
+#include "memory.hpp"
+
+#include <malloc.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+// the usable size is what's actually taken up, and it can be found again when the memory is freed,
+// which the size passed to operator delete can't always be
+[[nodiscard]] auto usableSize(void* pointer) noexcept -> std::size_t
+{
+#ifdef _WIN32
+    return _msize(pointer);
+#else
+    return malloc_usable_size(pointer);
+#endif
+}
+
+[[nodiscard]] auto countedAllocate(std::size_t size) -> void*
+{
+    const auto pointer = std::malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc{};
+    }
+
+    compdbvs::detail::recordAllocation(usableSize(pointer));
+    return pointer;
+}
+
+auto countedFree(void* pointer) noexcept -> void
+{
+    if (pointer == nullptr) {
+        return;
+    }
+
+    compdbvs::detail::recordDeallocation(usableSize(pointer));
+    std::free(pointer);
+}
+
+// so allocationCountingEnabled() knows these replacements were linked in
+[[maybe_unused]] const auto s_enabled = [] {
+    compdbvs::detail::setAllocationCountingEnabled();
+    return true;
+}();
+} // namespace
+
+// the nothrow and sized versions all end up in these by default.
+// over-aligned allocations aren't replaced, nothing here makes any
+void* operator new(std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    countedFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    countedFree(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    countedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    countedFree(pointer);
+}
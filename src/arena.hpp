@@ -0,0 +1,92 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_ARENA_HPP
+#define COMPDBVS_ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+
+namespace compdbvs {
+// bump allocator for strings that live until the end of the run.
+// nothing is ever freed individually, the blocks all go when the arena does,
+// and moving the arena doesn't move the strings so views into it stay valid
+class StringArena
+{
+public:
+    StringArena()
+        : m_resource{std::make_unique<std::pmr::monotonic_buffer_resource>(s_initialBlockSize)}
+    {
+
+    }
+
+    StringArena(const StringArena&) = delete;
+    StringArena(StringArena&&) noexcept = default;
+    StringArena& operator=(const StringArena&) = delete;
+    StringArena& operator=(StringArena&&) noexcept = default;
+    ~StringArena() = default;
+
+    [[nodiscard]] auto intern(std::string_view string) -> std::string_view
+    {
+        return concat({string});
+    }
+
+    // copies all the parts into one contiguous string, so splicing a command doesn't need a temporary
+    [[nodiscard]] auto concat(std::initializer_list<std::string_view> parts) -> std::string_view
+    {
+        auto size = std::size_t{0};
+        for (const auto part : parts) {
+            size += part.size();
+        }
+
+        if (size == 0) {
+            return {};
+        }
+
+        const auto data = static_cast<char*>(m_resource->allocate(size, alignof(char)));
+        auto out = data;
+        for (const auto part : parts) {
+            out = std::ranges::copy(part, out).out;
+        }
+
+        m_bytesUsed += size;
+        return {data, size};
+    }
+
+    [[nodiscard]] auto bytesUsed() const noexcept -> std::size_t
+    {
+        return m_bytesUsed;
+    }
+
+private:
+    static constexpr std::size_t s_initialBlockSize = 64 * 1024;
+
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> m_resource;
+    std::size_t m_bytesUsed = 0;
+};
+} // namespace compdbvs
+
+#endif // #ifndef COMPDBVS_ARENA_HPP
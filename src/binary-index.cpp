@@ -0,0 +1,373 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "binary-index.hpp"
+#include "paths.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <ranges>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace compdbvs {
+using detail::BinaryFlagSet;
+using detail::BinaryIndexHeader;
+using detail::BinaryIndexRecord;
+using detail::BinaryStringRef;
+
+[[nodiscard]] auto writeBinaryIndex(
+    std::ostream& stream,
+    std::span<const CompileCommand> compileCommands
+) -> Result<std::size_t, std::runtime_error>
+{
+    std::string strings;
+    std::unordered_map<std::string, BinaryStringRef> stringRefs;
+
+    auto tooLarge = false;
+    auto addString = [&] (std::string_view string) -> BinaryStringRef {
+        if (string.empty()) {
+            return {0, 0};
+        }
+
+        if (const auto it = stringRefs.find(std::string{string}); it != stringRefs.end()) {
+            return it->second;
+        }
+
+        if (strings.size() + string.size() > std::numeric_limits<std::uint32_t>::max()) {
+            tooLarge = true;
+            return {0, 0};
+        }
+
+        const BinaryStringRef stringRef{static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(string.size())};
+        strings.append(string);
+        stringRefs.emplace(string, stringRef);
+        return stringRef;
+    };
+
+    // the strings are deduplicated, so two flag sets are the same if their refs are
+    std::vector<BinaryFlagSet> flagSets;
+    std::map<std::tuple<std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t, bool>, std::uint32_t> flagSetIndices;
+
+    std::vector<std::pair<std::string, BinaryIndexRecord>> records;
+    records.reserve(compileCommands.size());
+
+    for (const auto& compileCommand : compileCommands) {
+        const auto filePos = compileCommand.command.rfind(compileCommand.file);
+        const auto hasFile = filePos != std::string_view::npos;
+        const auto before = addString(compileCommand.command.substr(0_uz, filePos));
+        const auto after = !hasFile
+            ? BinaryStringRef{0, 0}
+            : addString(compileCommand.command.substr(filePos + compileCommand.file.size()));
+
+        const auto flagSetKey = std::make_tuple(before.offset, before.size, after.offset, after.size, hasFile);
+        auto flagSetIt = flagSetIndices.find(flagSetKey);
+        if (flagSetIt == flagSetIndices.end()) {
+            flagSetIt = flagSetIndices.emplace(flagSetKey, static_cast<std::uint32_t>(flagSets.size())).first;
+            flagSets.push_back(BinaryFlagSet{before, after, hasFile ? 1u : 0u, 0});
+        }
+
+        auto foldedFile = detail::foldPath(compileCommand.file);
+        const BinaryIndexRecord record{
+            .foldedFile = addString(foldedFile),
+            .file = addString(compileCommand.file),
+            .directory = addString(compileCommand.directory),
+            .owner = addString(compileCommand.owner),
+            .flagSet = flagSetIt->second,
+            .reserved = 0,
+        };
+
+        records.emplace_back(std::move(foldedFile), record);
+    }
+
+    if (tooLarge) {
+        return std::runtime_error{"Too many commands to fit in a binary index"};
+    }
+
+    std::ranges::stable_sort(records, {}, &std::pair<std::string, BinaryIndexRecord>::first);
+
+    const auto recordsOffset = sizeof(BinaryIndexHeader);
+    const auto flagSetsOffset = recordsOffset + records.size() * sizeof(BinaryIndexRecord);
+    const auto stringsOffset = flagSetsOffset + flagSets.size() * sizeof(BinaryFlagSet);
+
+    if (stringsOffset + strings.size() > std::numeric_limits<std::uint32_t>::max()) {
+        return std::runtime_error{"Too many commands to fit in a binary index"};
+    }
+
+    const BinaryIndexHeader header{
+        .magic = detail::g_binaryIndexMagic,
+        .version = detail::g_binaryIndexVersion,
+        .recordCount = static_cast<std::uint32_t>(records.size()),
+        .flagSetCount = static_cast<std::uint32_t>(flagSets.size()),
+        .recordsOffset = static_cast<std::uint32_t>(recordsOffset),
+        .flagSetsOffset = static_cast<std::uint32_t>(flagSetsOffset),
+        .stringsOffset = static_cast<std::uint32_t>(stringsOffset),
+        .stringsSize = static_cast<std::uint32_t>(strings.size()),
+        .reserved = 0,
+    };
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& [foldedFile, record] : records) {
+        stream.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+    stream.write(reinterpret_cast<const char*>(flagSets.data()), static_cast<std::streamsize>(flagSets.size() * sizeof(BinaryFlagSet)));
+    stream.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+    return records.size();
+}
+
+[[nodiscard]] auto IndexedCompileCommand::command() const -> std::string
+{
+    if (!commandHasFile) {
+        return std::string{commandBefore};
+    }
+
+    std::string result;
+    result.reserve(commandBefore.size() + file.size() + commandAfter.size());
+    result.append(commandBefore).append(file).append(commandAfter);
+    return result;
+}
+
+[[nodiscard]] auto BinaryIndexReader::open(std::span<const std::byte> data) -> Result<BinaryIndexReader, std::runtime_error>
+{
+    BinaryIndexHeader header;
+    if (data.size() < sizeof(header)) {
+        return std::runtime_error{"Binary index is too small to have a header"};
+    }
+
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    if (header.magic != detail::g_binaryIndexMagic) {
+        return std::runtime_error{"Not a compdb-vs binary index"};
+    }
+
+    if (header.version != detail::g_binaryIndexVersion) {
+        return std::runtime_error{fmt::format("Unsupported binary index version {}", header.version)};
+    }
+
+    // 64 bit so none of this can overflow
+    const auto recordsEnd = std::uint64_t{header.recordsOffset} + std::uint64_t{header.recordCount} * sizeof(BinaryIndexRecord);
+    const auto flagSetsEnd = std::uint64_t{header.flagSetsOffset} + std::uint64_t{header.flagSetCount} * sizeof(BinaryFlagSet);
+    const auto stringsEnd = std::uint64_t{header.stringsOffset} + header.stringsSize;
+
+    if (recordsEnd > data.size() || flagSetsEnd > data.size() || stringsEnd > data.size()) {
+        return std::runtime_error{"Binary index is truncated"};
+    }
+
+    return BinaryIndexReader{data, header};
+}
+
+BinaryIndexReader::BinaryIndexReader(std::span<const std::byte> data, const BinaryIndexHeader& header)
+    : m_data{data}
+    , m_header{header}
+{
+
+}
+
+[[nodiscard]] auto BinaryIndexReader::operator[](std::size_t index) const -> IndexedCompileCommand
+{
+    const auto indexRecord = record(index);
+    if (indexRecord.flagSet >= m_header.flagSetCount) {
+        throw std::runtime_error{"Binary index is corrupt"};
+    }
+
+    BinaryFlagSet flagSet;
+    std::memcpy(&flagSet, m_data.data() + m_header.flagSetsOffset + indexRecord.flagSet * sizeof(BinaryFlagSet), sizeof(flagSet));
+
+    return IndexedCompileCommand{
+        .directory = string(indexRecord.directory),
+        .file = string(indexRecord.file),
+        .owner = string(indexRecord.owner),
+        .commandBefore = string(flagSet.before),
+        .commandAfter = string(flagSet.after),
+        .commandHasFile = flagSet.hasFile != 0,
+    };
+}
+
+[[nodiscard]] auto BinaryIndexReader::find(std::string_view file) const -> std::optional<IndexedCompileCommand>
+{
+    const auto foldedFile = detail::foldPath(file);
+
+    const auto indices = std::views::iota(0_uz, size());
+    const auto it = std::ranges::partition_point(indices, [this, &foldedFile] (std::size_t index) {
+        return string(record(index).foldedFile) < foldedFile;
+    });
+
+    if (it == indices.end() || string(record(*it).foldedFile) != foldedFile) {
+        return std::nullopt;
+    }
+
+    return (*this)[*it];
+}
+
+[[nodiscard]] auto BinaryIndexReader::record(std::size_t index) const -> BinaryIndexRecord
+{
+    if (index >= m_header.recordCount) {
+        throw std::out_of_range{fmt::format("Binary index record {} out of range", index)};
+    }
+
+    // copied out rather than cast in place, the data doesn't have to be aligned
+    BinaryIndexRecord result;
+    std::memcpy(&result, m_data.data() + m_header.recordsOffset + index * sizeof(BinaryIndexRecord), sizeof(result));
+    return result;
+}
+
+[[nodiscard]] auto BinaryIndexReader::string(BinaryStringRef stringRef) const -> std::string_view
+{
+    if (std::uint64_t{stringRef.offset} + stringRef.size > m_header.stringsSize) {
+        throw std::runtime_error{"Binary index is corrupt"};
+    }
+
+    return {reinterpret_cast<const char*>(m_data.data()) + m_header.stringsOffset + stringRef.offset, stringRef.size};
+}
+
+[[nodiscard]] auto MappedFile::open(const std::filesystem::path& path) -> Result<MappedFile, std::runtime_error>
+{
+    MappedFile mappedFile;
+
+#ifdef _WIN32
+    const auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return std::runtime_error{fmt::format("Failed to open {}", path.string())};
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return std::runtime_error{fmt::format("Failed to get the size of {}", path.string())};
+    }
+
+    // an empty file can't be mapped, but it's still a valid (empty) view
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return mappedFile;
+    }
+
+    const auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return std::runtime_error{fmt::format("Failed to map {}", path.string())};
+    }
+
+    const auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        return std::runtime_error{fmt::format("Failed to map {}", path.string())};
+    }
+
+    mappedFile.m_mapping = mapping;
+    mappedFile.m_data = static_cast<const std::byte*>(view);
+    mappedFile.m_size = static_cast<std::size_t>(size.QuadPart);
+#else
+    const auto file = ::open(path.c_str(), O_RDONLY);
+    if (file == -1) {
+        return std::runtime_error{fmt::format("Failed to open {}", path.string())};
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0) {
+        ::close(file);
+        return std::runtime_error{fmt::format("Failed to get the size of {}", path.string())};
+    }
+
+    if (status.st_size == 0) {
+        ::close(file);
+        return mappedFile;
+    }
+
+    const auto size = static_cast<std::size_t>(status.st_size);
+    const auto view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (view == MAP_FAILED) {
+        return std::runtime_error{fmt::format("Failed to map {}", path.string())};
+    }
+
+    mappedFile.m_data = static_cast<const std::byte*>(view);
+    mappedFile.m_size = size;
+#endif
+
+    return mappedFile;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_data{std::exchange(other.m_data, nullptr)}
+    , m_size{std::exchange(other.m_size, 0)}
+#ifdef _WIN32
+    , m_mapping{std::exchange(other.m_mapping, nullptr)}
+#endif
+{
+
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+        m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+    }
+
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+auto MappedFile::close() noexcept -> void
+{
+    if (m_data == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    m_mapping = nullptr;
+#else
+    munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+}
+} // namespace compdbvs
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_BINARY_INDEX_HPP
+#define COMPDBVS_BINARY_INDEX_HPP
+
+#include "compdb-vs.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// a sidecar to compile_commands.json for tools that want to look entries up without parsing JSON.
+// it's laid out so it can be mapped into memory and used as it is:
+//
+//     header
+//     records, sorted by the folded (see detail::foldPath) file path so they can be binary searched
+//     flag sets, the command of each entry with its file cut out. entries from the same project
+//         usually share one, so each distinct one is only stored once
+//     strings, every string the records and flag sets point at, also only stored once
+//
+// everything is little endian, and every offset is from the start of the file
+namespace compdbvs {
+static_assert(std::endian::native == std::endian::little, "the binary index is written and read as it is in memory");
+
+namespace detail {
+inline constexpr std::uint64_t g_binaryIndexMagic = 0x5844'4953'5642'4443; // "CDBVSIDX"
+inline constexpr std::uint32_t g_binaryIndexVersion = 2;
+
+struct BinaryStringRef
+{
+    std::uint32_t offset;
+    std::uint32_t size;
+};
+
+struct BinaryIndexHeader
+{
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t recordCount;
+    std::uint32_t flagSetCount;
+    std::uint32_t recordsOffset;
+    std::uint32_t flagSetsOffset;
+    std::uint32_t stringsOffset;
+    std::uint32_t stringsSize;
+    std::uint32_t reserved;
+};
+
+struct BinaryIndexRecord
+{
+    BinaryStringRef foldedFile;
+    BinaryStringRef file;
+    BinaryStringRef directory;
+    BinaryStringRef owner;
+    std::uint32_t flagSet;
+    std::uint32_t reserved;
+};
+
+// the command is before + file + after, or just before if the command doesn't spell the file
+// the way the entry does (other separators, quotes), so there was nowhere to cut it out
+struct BinaryFlagSet
+{
+    BinaryStringRef before;
+    BinaryStringRef after;
+    std::uint32_t hasFile;
+    std::uint32_t reserved;
+};
+} // namespace detail
+
+// writes the index for compileCommands, stream has to be opened in binary mode.
+// offsets are 32 bit, so this fails if the strings would add up to more than 4GB
+[[nodiscard]] auto writeBinaryIndex(
+    std::ostream& stream,
+    std::span<const CompileCommand> compileCommands
+) -> Result<std::size_t, std::runtime_error>;
+
+// an entry read back out of an index, the strings are views into the index's memory
+struct IndexedCompileCommand
+{
+    std::string_view directory;
+    std::string_view file;
+    std::string_view owner;
+    std::string_view commandBefore;
+    std::string_view commandAfter;
+    bool commandHasFile = true;
+
+    // the command isn't stored in one piece, so this puts it back together
+    [[nodiscard]] auto command() const -> std::string;
+};
+
+// reads an index in place, nothing is copied or parsed apart from checking the header and that
+// the sections fit in the data. the data has to outlive the reader
+class BinaryIndexReader
+{
+public:
+    [[nodiscard]] static auto open(std::span<const std::byte> data) -> Result<BinaryIndexReader, std::runtime_error>;
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t
+    {
+        return m_header.recordCount;
+    }
+
+    [[nodiscard]] auto operator[](std::size_t index) const -> IndexedCompileCommand;
+
+    // binary search for a file, ignoring case and which separators are used
+    [[nodiscard]] auto find(std::string_view file) const -> std::optional<IndexedCompileCommand>;
+
+private:
+    BinaryIndexReader(std::span<const std::byte> data, const detail::BinaryIndexHeader& header);
+
+    [[nodiscard]] auto record(std::size_t index) const -> detail::BinaryIndexRecord;
+    [[nodiscard]] auto string(detail::BinaryStringRef stringRef) const -> std::string_view;
+
+    std::span<const std::byte> m_data;
+    detail::BinaryIndexHeader m_header;
+};
+
+// a read-only view of a whole file mapped into memory, for handing to BinaryIndexReader
+class MappedFile
+{
+public:
+    [[nodiscard]] static auto open(const std::filesystem::path& path) -> Result<MappedFile, std::runtime_error>;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    [[nodiscard]] auto bytes() const noexcept -> std::span<const std::byte>
+    {
+        return {m_data, m_size};
+    }
+
+private:
+    MappedFile() = default;
+
+    auto close() noexcept -> void;
+
+    const std::byte* m_data = nullptr;
+    std::size_t m_size = 0;
+#ifdef _WIN32
+    void* m_mapping = nullptr;
+#endif
+};
+} // namespace compdbvs
+
+#endif // #ifndef COMPDBVS_BINARY_INDEX_HPP
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_BOUNDED_QUEUE_HPP
+#define COMPDBVS_BOUNDED_QUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace compdbvs::detail {
+// a queue between pipeline stages that holds at most capacity items. push waits while it's full,
+// which is what stops a fast stage from getting too far ahead of a slow one, and pop waits while it's empty.
+// once it's closed nothing more can be pushed, and pop gives back what's left followed by nullopt
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(std::size_t capacity)
+        : m_capacity{capacity == 0 ? 1 : capacity}
+    {
+
+    }
+
+    // false if the queue was closed, in which case item is dropped
+    [[nodiscard]] auto push(T item) -> bool
+    {
+        std::unique_lock lock{m_mutex};
+        m_notFull.wait(lock, [this] {
+            return m_closed || m_items.size() < m_capacity;
+        });
+
+        if (m_closed) {
+            return false;
+        }
+
+        m_items.push_back(std::move(item));
+        lock.unlock();
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    [[nodiscard]] auto pop() -> std::optional<T>
+    {
+        std::unique_lock lock{m_mutex};
+        m_notEmpty.wait(lock, [this] {
+            return m_closed || !m_items.empty();
+        });
+
+        if (m_items.empty()) {
+            return std::nullopt;
+        }
+
+        auto item = std::move(m_items.front());
+        m_items.pop_front();
+        lock.unlock();
+        m_notFull.notify_one();
+        return item;
+    }
+
+    auto close() -> void
+    {
+        {
+            const std::lock_guard lock{m_mutex};
+            m_closed = true;
+        }
+
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+    std::deque<T> m_items;
+    std::size_t m_capacity;
+    bool m_closed = false;
+};
+} // namespace compdbvs::detail
+
+#endif // #ifndef COMPDBVS_BOUNDED_QUEUE_HPP
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "casing-resolver.hpp"
+#include "compdb-vs.hpp"
+#include "trace.hpp"
+
+#include <optional>
+#include <utility>
+
+namespace compdbvs::detail {
+namespace fs = std::filesystem;
+
+namespace {
+struct TrieNode
+{
+    // the component as it was asked for, or the whole root (C:\ or /) for the top nodes
+    fs::path name;
+    std::unordered_map<PathKey, std::size_t> children;
+    // the paths that end at this node
+    std::vector<std::size_t> pathIndices;
+    // filled in on the way down
+    fs::path resolved;
+};
+} // namespace
+
+CasingResolver::CasingResolver(FileSystem& fileSystem)
+    : m_fileSystem{fileSystem}
+{
+}
+
+[[nodiscard]] auto CasingResolver::resolve(std::span<const fs::path> paths) -> std::vector<Result<fs::path, Error>>
+{
+    COMPDBVS_TRACE_SCOPE_DETAIL("Resolve casing", "{} paths", paths.size());
+
+    std::vector<TrieNode> nodes;
+    std::unordered_map<PathKey, std::size_t> roots;
+
+    // nodes is looked up again after growing it, since that moves every node's children
+    auto addChild = [&nodes, &roots] (std::optional<std::size_t> parent, const fs::path& name) -> std::size_t {
+        PathKey key{name.string()};
+        const auto& children = parent ? nodes[*parent].children : roots;
+        if (const auto it = children.find(key); it != children.end()) {
+            return it->second;
+        }
+
+        const auto index = nodes.size();
+        nodes.push_back(TrieNode{.name = name, .children = {}, .pathIndices = {}, .resolved = {}});
+        (parent ? nodes[*parent].children : roots).emplace(std::move(key), index);
+        return index;
+    };
+
+    for (auto pathIndex = 0_uz; pathIndex < paths.size(); pathIndex++) {
+        const auto path = paths[pathIndex].lexically_normal();
+
+        // the root (a drive, or the first component of a relative path) is taken as it is, like getCorrectCasingForPath does
+        auto component = path.begin();
+        if (component == path.end()) {
+            continue;
+        }
+
+        auto root = *component++;
+        if (path.has_root_name() && path.has_root_directory() && component != path.end()) {
+            root /= *component++;
+        }
+
+        auto node = addChild(std::nullopt, root);
+        for (; component != path.end(); ++component) {
+            // a trailing separator gives an empty last component
+            if (!component->empty()) {
+                node = addChild(node, *component);
+            }
+        }
+
+        nodes[node].pathIndices.push_back(pathIndex);
+    }
+
+    std::vector<std::optional<Result<fs::path, Error>>> results(paths.size());
+
+    // everything at or under node gets error, or NotFound if there isn't one
+    auto fail = [&nodes, &results, &paths] (std::size_t node, const std::optional<Error>& error) {
+        std::vector<std::size_t> stack{node};
+        while (!stack.empty()) {
+            const auto& current = nodes[stack.back()];
+            stack.pop_back();
+
+            for (const auto pathIndex : current.pathIndices) {
+                results[pathIndex] = error ? *error : Error{ErrorCode::NotFound, paths[pathIndex]};
+            }
+
+            for (const auto& [key, child] : current.children) {
+                stack.push_back(child);
+            }
+        }
+    };
+
+    std::vector<std::size_t> stack;
+    for (const auto& [key, root] : roots) {
+        auto& node = nodes[root];
+        if (!node.pathIndices.empty() && !m_fileSystem.exists(node.name)) {
+            fail(root, std::nullopt);
+            continue;
+        }
+
+        node.resolved = node.name;
+        for (const auto pathIndex : node.pathIndices) {
+            results[pathIndex] = node.resolved;
+        }
+
+        stack.push_back(root);
+    }
+
+    while (!stack.empty()) {
+        const auto directory = stack.back();
+        stack.pop_back();
+
+        if (nodes[directory].children.empty()) {
+            continue;
+        }
+
+        const auto& listing = list(nodes[directory].resolved);
+        if (!listing) {
+            // only roots can fail to list because they're missing, anything below was seen as a directory in its parent
+            if (!m_fileSystem.exists(nodes[directory].resolved)) {
+                for (const auto& [key, child] : nodes[directory].children) {
+                    fail(child, std::nullopt);
+                }
+            } else {
+                for (const auto& [key, child] : nodes[directory].children) {
+                    fail(child, listing.error());
+                }
+            }
+            continue;
+        }
+
+        for (const auto& [key, child] : nodes[directory].children) {
+            const auto entry = listing->find(nodes[child].name);
+            if (entry == nullptr) {
+                fail(child, std::nullopt);
+                continue;
+            }
+
+            auto& childNode = nodes[child];
+            childNode.resolved = entry->path;
+            for (const auto pathIndex : childNode.pathIndices) {
+                results[pathIndex] = childNode.resolved;
+            }
+
+            if (!childNode.children.empty()) {
+                if (entry->isDirectory) {
+                    stack.push_back(child);
+                } else {
+                    // something below a file can't exist
+                    for (const auto& [grandchildKey, grandchild] : childNode.children) {
+                        fail(grandchild, std::nullopt);
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<Result<fs::path, Error>> resolved;
+    resolved.reserve(paths.size());
+    for (auto pathIndex = 0_uz; pathIndex < paths.size(); pathIndex++) {
+        // only an empty path never reaches a node
+        resolved.push_back(results[pathIndex] ? std::move(*results[pathIndex]) : Error{ErrorCode::NotFound, paths[pathIndex]});
+    }
+
+    return resolved;
+}
+
+[[nodiscard]] auto CasingResolver::list(const fs::path& directory) -> const Result<Listing, Error>&
+{
+    PathKey key{directory.string()};
+    if (const auto it = m_listings.find(key); it != m_listings.end()) {
+        return it->second;
+    }
+
+    auto entries = m_fileSystem.listDirectory(directory);
+    if (!entries) {
+        return m_listings.emplace(std::move(key), entries.error()).first->second;
+    }
+
+    // at most half full, so probes stay short
+    auto slotCount = 16_uz;
+    while (slotCount < entries->size() * 2_uz) {
+        slotCount *= 2_uz;
+    }
+
+    Listing listing{.entries = std::move(*entries), .slots = std::vector<std::uint32_t>(slotCount, 0)};
+    for (auto i = 0_uz; i < listing.entries.size(); i++) {
+        auto slot = hashIgnoreCase(filenameView(listing.entries[i].path)) & (slotCount - 1_uz);
+        while (listing.slots[slot] != 0) {
+            slot = (slot + 1_uz) & (slotCount - 1_uz);
+        }
+        listing.slots[slot] = static_cast<std::uint32_t>(i + 1_uz);
+    }
+
+    return m_listings.emplace(std::move(key), std::move(listing)).first->second;
+}
+
+[[nodiscard]] auto CasingResolver::Listing::find(const fs::path& name) const noexcept -> const DirectoryEntry*
+{
+    const std::basic_string_view<fs::path::value_type> wanted = name.native();
+    const auto mask = slots.size() - 1_uz;
+    for (auto slot = hashIgnoreCase(wanted) & mask; slots[slot] != 0; slot = (slot + 1_uz) & mask) {
+        const auto& entry = entries[slots[slot] - 1_uz];
+        if (equalsIgnoreCase(filenameView(entry.path), wanted)) {
+            return &entry;
+        }
+    }
+
+    return nullptr;
+}
+} // namespace compdbvs::detail
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_CASING_RESOLVER_HPP
+#define COMPDBVS_CASING_RESOLVER_HPP
+
+#include "filesystem.hpp"
+#include "paths.hpp"
+#include "result.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace compdbvs::detail {
+// getCorrectCasingForPath for a lot of paths at once. fixing one path means listing every directory above it,
+// and most paths share nearly all of those, so a batch is put into a trie of path components and walked top down,
+// with each directory listed once and all of the children asked for under it matched against that one listing.
+// listings are kept between batches as well, so each directory is only ever listed once
+class CasingResolver
+{
+public:
+    explicit CasingResolver(FileSystem& fileSystem);
+
+    // one result per path, in the same order. paths that don't exist give ErrorCode::NotFound
+    [[nodiscard]] auto resolve(std::span<const std::filesystem::path> paths) -> std::vector<Result<std::filesystem::path, Error>>;
+
+    // how many directories have been listed so far
+    [[nodiscard]] auto listingCount() const noexcept -> std::size_t
+    {
+        return m_listings.size();
+    }
+
+private:
+    // a directory's entries, with an open addressed table of their indices keyed by hashIgnoreCase of their names.
+    // directories can have thousands of entries and only a few of them are ever looked up,
+    // so the names are hashed where they are rather than each being folded into a key of its own
+    struct Listing
+    {
+        std::vector<DirectoryEntry> entries;
+        // index + 1 into entries, 0 for an empty slot. the size is a power of two
+        std::vector<std::uint32_t> slots;
+
+        [[nodiscard]] auto find(const std::filesystem::path& name) const noexcept -> const DirectoryEntry*;
+    };
+
+    [[nodiscard]] auto list(const std::filesystem::path& directory) -> const Result<Listing, Error>&;
+
+    FileSystem& m_fileSystem;
+    std::unordered_map<PathKey, Result<Listing, Error>> m_listings;
+};
+} // namespace compdbvs::detail
+
+#endif // #ifndef COMPDBVS_CASING_RESOLVER_HPP
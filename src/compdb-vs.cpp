@@ -21,160 +21,875 @@
 */
 
 #include "compdb-vs.hpp"
-
+#include "bounded-queue.hpp"
+#include "casing-resolver.hpp"
+#include "flags.hpp"
+#include "path-index.hpp"
+#include "paths.hpp"
+#include "scanner.hpp"
+#include "trace.hpp"
+#include "vcxproj.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <sstream>
+#include <iterator>
+#include <optional>
 #include <ranges>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace compdbvs {
-bool g_verbose = false;
-
 auto findTlogFiles(
     const fs::path& buildDir,
-    std::string_view config
+    std::string_view config,
+    FileSystem& fileSystem
 ) -> Result<std::vector<fs::path>, std::runtime_error>
 {
-    if (!fs::is_directory(buildDir)) {
-        return std::runtime_error{fmt::format("{} is not a directory", buildDir.string())};
+    std::vector<fs::path> tlogFiles;
+    const auto found = detail::visitTlogDirectories(buildDir, config, [&tlogFiles] (std::vector<fs::path> directoryTlogs) {
+        std::ranges::move(directoryTlogs, std::back_inserter(tlogFiles));
+        return true;
+    }, fileSystem);
+
+    if (!found) {
+        return found.error();
     }
 
-    // recursing can cause a stack overflow for very large projects
-    // so do a loop advancing one level through the file tree at a time
-    try {
-        std::vector<fs::path> tlogFiles;
-        std::vector<fs::path> dirsToCheck{buildDir};
-
-        while (!dirsToCheck.empty()) {
-            std::vector<fs::path> innerDirs;
-
-            for (const auto& dir : dirsToCheck) {
-                for (const auto& entry : fs::directory_iterator{dir}) {
-                    const auto& path = entry.path();
-                    if (fs::is_directory(path)) {
-                        innerDirs.push_back(path);
-                    } else {
-                        const auto parent = path.parent_path().parent_path();
-                        if (parent.filename() == config && path.filename() == "CL.command.1.tlog") {
-                            tlogFiles.push_back(path);
+    return tlogFiles;
+}
+
+auto findVcxprojFiles(
+    const fs::path& buildDir,
+    FileSystem& fileSystem
+) -> Result<std::vector<fs::path>, std::runtime_error>
+{
+    std::vector<fs::path> vcxprojFiles;
+    const auto found = detail::visitVcxprojFiles(buildDir, [&vcxprojFiles] (fs::path vcxprojFile) {
+        vcxprojFiles.push_back(std::move(vcxprojFile));
+        return true;
+    }, fileSystem);
+
+    if (!found) {
+        return found.error();
+    }
+
+    return vcxprojFiles;
+}
+
+namespace {
+// a command from a tlog, the source file is still upper case
+struct TlogCommand
+{
+    std::string line;
+    // where the source file starts in line, everything before it is the flags
+    std::size_t fileStart;
+
+    [[nodiscard]] auto fileName() const noexcept -> std::string_view
+    {
+        return std::string_view{line}.substr(fileStart);
+    }
+};
+
+// a project's newest command for each of its files, in the order the files were first seen
+struct ParsedProject
+{
+    std::string name;
+    std::vector<TlogCommand> commands;
+    std::vector<detail::PathKey> files;
+};
+
+// where a project's tlogs go to be parsed, and where the result comes back
+struct ParseJob
+{
+    std::vector<fs::path> files;
+    // where the project comes in the output, earlier projects get first claim on a file
+    std::uint64_t order;
+    std::promise<Result<ParsedProject, std::runtime_error>> parsed;
+};
+
+// how many projects can be found but not yet visited. this is what keeps memory bounded
+// when finding tlogs is a lot quicker than parsing them, or parsing is quicker than fixing casing
+inline constexpr std::size_t g_maxProjectsInFlight = 16;
+
+[[nodiscard]] auto parseTlog(
+    const fs::path& file,
+    std::string_view contents,
+    const Options& options
+) -> Result<std::vector<TlogCommand>, std::runtime_error>
+{
+    static constexpr std::array<std::string_view, 6> extensions = {
+        ".C", ".CC", ".CPP", ".CXX", ".M", ".MM"
+    };
+
+    COMPDBVS_TRACE_SCOPE_DETAIL("Parse tlog", "{}", file.string());
+    COMPDBVS_LOG("File: {}\n", file.string());
+
+    std::vector<std::string> lines;
+
+    if (file.extension() == ".vcxproj") {
+        // the XML reader works straight from the file's contents, it has no use for them split into lines
+        auto vcxprojLines = detail::readVcxprojCommands(contents, file.parent_path(), options.configuration);
+        if (!vcxprojLines) {
+            return vcxprojLines.error();
+        }
+
+        lines = std::move(*vcxprojLines);
+    } else {
+        lines = detail::readFileLines(contents);
+    }
+
+    std::vector<TlogCommand> commands;
+
+    for (auto& line : lines) {
+        if (!line.starts_with("/c")) {
+            continue;
+        }
+
+        COMPDBVS_LOG("Command: {}\n", line);
+
+        // the tlogs are all upper case, but the paths in a .vcxproj aren't
+        if (std::ranges::none_of(extensions, [&line] (const auto extension) {
+            return line.size() >= extension.size() && std::ranges::equal(
+                std::string_view{line}.substr(line.size() - extension.size()),
+                extension,
+                [] (const char a, const char b) {
+                    return std::toupper(static_cast<unsigned char>(a)) == b;
+                }
+            );
+        })) {
+            return std::runtime_error{fmt::format("Command did not end with source file: {}", line)};
+        }
+
+        // go from the end of the command until we find the last occurrence of a Windows drive letter and ':'
+        // that will be the start of the full path to the source file
+        for (auto i = line.size() - 2_uz; i > 0_uz; i--) {
+            if (std::isalpha(line[i]) && line[i + 1_uz] == ':') {
+                commands.push_back(TlogCommand{.line = std::move(line), .fileStart = i});
+                break;
+            }
+        }
+    }
+
+    return commands;
+}
+
+[[nodiscard]] auto parseProject(
+    const std::vector<fs::path>& files,
+    const Options& options,
+    FileSystem& fileSystem
+) -> Result<ParsedProject, std::runtime_error>
+{
+    ParsedProject project{.name = detail::findProjectName(files.front()), .commands = {}, .files = {}};
+
+    // findTlogFiles gives a project's tlogs oldest first, so when a file was rebuilt without a clean
+    // the command from the newest tlog is the one it was last built with. files keep the place they were first seen in
+    std::unordered_map<detail::PathKey, std::size_t> commandIndices;
+
+    // a project's tlogs are all read together
+    const auto contents = fileSystem.readFiles(files);
+
+    for (auto i = 0_uz; i < files.size(); i++) {
+        const auto& file = files[i];
+        if (!contents[i]) {
+            return std::runtime_error{fmt::format("Failed to open {}", file.string())};
+        }
+
+        auto tlogCommands = parseTlog(file, *contents[i], options);
+        if (!tlogCommands) {
+            return tlogCommands.error();
+        }
+
+        for (auto& tlogCommand : *tlogCommands) {
+            detail::PathKey fileKey{tlogCommand.fileName()};
+            const auto [it, inserted] = commandIndices.try_emplace(fileKey, project.commands.size());
+            if (inserted) {
+                project.commands.push_back(std::move(tlogCommand));
+                project.files.push_back(std::move(fileKey));
+            } else {
+                project.commands[it->second] = std::move(tlogCommand);
+            }
+        }
+    }
+
+    return project;
+}
+
+// calls visitor with the input files of each project, in the order their entries should come out.
+// visitor returns false when it doesn't want any more
+using ProjectInputs = std::function<Result<std::size_t, std::runtime_error>(const std::function<bool(std::vector<fs::path>)>& visitor)>;
+
+// the source entries are made in a pipeline: one thread finds each project's inputs, workers parse them,
+// and this thread fixes the casing of each project's files and visits them in the order the projects were found.
+// the stages are joined by bounded queues, so parsing starts as soon as the first project is found,
+// the first entries come out as soon as the first project is parsed, and no stage can get far ahead of the others
+[[nodiscard]] auto visitCompileCommandsFrom(
+    const fs::path& buildDir,
+    const ProjectInputs& projectInputs,
+    const CompileCommandVisitor& visitor,
+    const Options& options,
+    FileSystem& fileSystem
+) -> Result<std::size_t, std::runtime_error>
+{
+    using ParsedFuture = std::future<Result<ParsedProject, std::runtime_error>>;
+
+    detail::BoundedQueue<ParseJob> parseQueue{g_maxProjectsInFlight};
+    // the results in the order the projects were found, so the output doesn't depend on which worker finished first
+    detail::BoundedQueue<ParsedFuture> parsedQueue{g_maxProjectsInFlight};
+    // only set before the queues are closed, so it's safe to read once parsedQueue runs out
+    std::optional<std::runtime_error> findError;
+
+    // a file built by more than one project keeps the command from the first. the workers claim each project's
+    // files as soon as it's parsed, and drop the ones an earlier project already has, so the visiting below
+    // only has to check the claims of projects that were parsed out of order
+    detail::ConcurrentPathIndex claimedFiles;
+
+    std::vector<std::jthread> threads;
+
+    // declared after the threads so it goes first: however this function is left, including by the visitor throwing,
+    // the stages waiting on a queue are let go before the threads are joined, rather than being waited on forever
+    struct QueueCloser
+    {
+        detail::BoundedQueue<ParseJob>& parseQueue;
+        detail::BoundedQueue<ParsedFuture>& parsedQueue;
+
+        ~QueueCloser()
+        {
+            parseQueue.close();
+            parsedQueue.close();
+        }
+    } queueCloser{parseQueue, parsedQueue};
+
+    threads.emplace_back([&] {
+        COMPDBVS_TRACE_SCOPE("Find project inputs");
+        auto order = std::uint64_t{0};
+        try {
+            const auto found = projectInputs([&] (std::vector<fs::path> files) {
+                ParseJob job{.files = std::move(files), .order = order++, .parsed = {}};
+                // parsedQueue fills up first when the visiting falls behind, which is what holds this back
+                return parsedQueue.push(job.parsed.get_future()) && parseQueue.push(std::move(job));
+            });
+
+            if (!found) {
+                findError = found.error();
+            }
+        } catch (const std::exception& e) {
+            findError = std::runtime_error{e.what()};
+        }
+
+        parseQueue.close();
+        parsedQueue.close();
+    });
+
+    // reading the tlogs is nearly all disk access, so there can be a worker per core
+    const auto workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+    for (auto i = 0u; i < workerCount; i++) {
+        threads.emplace_back([&] {
+            while (auto job = parseQueue.pop()) {
+                // anything thrown here is thrown again from parsed->get() below, on the thread that can report it
+                try {
+                    auto parsedProject = parseProject(job->files, options, fileSystem);
+                    if (parsedProject) {
+                        auto kept = 0_uz;
+                        for (auto file = 0_uz; file < parsedProject->files.size(); file++) {
+                            if (!claimedFiles.claim(parsedProject->files[file], job->order)) {
+                                continue;
+                            }
+
+                            if (kept != file) {
+                                parsedProject->commands[kept] = std::move(parsedProject->commands[file]);
+                                parsedProject->files[kept] = std::move(parsedProject->files[file]);
+                            }
+                            kept++;
                         }
+
+                        parsedProject->commands.resize(kept);
+                        parsedProject->files.resize(kept);
                     }
+
+                    job->parsed.set_value(std::move(parsedProject));
+                } catch (...) {
+                    job->parsed.set_exception(std::current_exception());
                 }
             }
+        });
+    }
 
-            dirsToCheck.swap(innerDirs);
+    // the source file entries are kept because the header entries are made from them,
+    // the header entries themselves are only ever held for as long as the visitor takes
+    CompileCommandStore sourceCompileCommands;
+    auto& arena = sourceCompileCommands.arena();
+    const auto directory = arena.intern(buildDir.string());
+
+    // duplicates are found from the upper case paths, so casing is only fixed for the files that get entries.
+    // the resolver keeps every directory it lists, so projects sharing directories don't list them again
+    detail::CasingResolver casingResolver{fileSystem};
+
+    auto visitProject = [&] (ParsedProject& parsedProject, std::uint64_t order) {
+        const auto project = arena.intern(parsedProject.name);
+
+        // every project before this one has been parsed and claimed its files by now,
+        // and a later one can't take a file away, so these claims are final
+        std::vector<const TlogCommand*> tlogCommands;
+        std::vector<fs::path> fileNames;
+        for (auto i = 0_uz; i < parsedProject.commands.size(); i++) {
+            if (claimedFiles.owner(parsedProject.files[i]) == order) {
+                tlogCommands.push_back(&parsedProject.commands[i]);
+                // paths in the tlog files seem to all be converted to all upper case.
+                fileNames.emplace_back(parsedProject.commands[i].fileName());
+            }
+        }
+
+        const auto correctCasings = casingResolver.resolve(fileNames);
+
+        for (auto i = 0_uz; i < tlogCommands.size(); i++) {
+            const auto tlogCommand = tlogCommands[i];
+            const auto& correctCasing = correctCasings[i];
+            if (!correctCasing) {
+                logWarning(
+                    "Failed to find source file \"{}\" in command \"{}\": \"{}\"\n",
+                    tlogCommand->fileName(),
+                    tlogCommand->line,
+                    correctCasing.error().what()
+                );
+                continue;
+            }
+
+            const auto targetFile = correctCasing->string();
+            COMPDBVS_LOG("Source File: {}\n", targetFile);
+
+            // the source file is always the last thing in the command,
+            // so the file can be a view of the end of the command rather than another copy
+            const auto flags = std::string_view{tlogCommand->line}.substr(0_uz, tlogCommand->fileStart);
+            const auto command = options.minimalCommands
+                ? arena.concat({"cl.exe ", detail::minimiseCommand(flags), " ", targetFile})
+                : arena.concat({"cl.exe ", flags, targetFile});
+
+            visitor(sourceCompileCommands.addInterned(CompileCommand{
+                .directory = directory,
+                .command = command,
+                .file = command.substr(command.size() - targetFile.size()),
+                .project = project,
+            }));
+        }
+    };
+
+    std::optional<std::runtime_error> parseError;
+    for (auto order = std::uint64_t{0}; auto parsed = parsedQueue.pop(); order++) {
+        auto parsedProject = parsed->get();
+        if (!parsedProject) {
+            parseError = parsedProject.error();
+            break;
+        }
+
+        visitProject(*parsedProject, order);
+    }
+
+    // stops the other stages if we gave up early, and waits for them either way
+    parseQueue.close();
+    parsedQueue.close();
+    threads.clear();
+
+    if (parseError) {
+        return *parseError;
+    }
+
+    if (findError) {
+        return *findError;
+    }
+
+    auto visitedCount = sourceCompileCommands.size();
+
+    if (!options.skipHeaders) {
+        logInfo("Sarching for header files\n");
+
+        const auto headerCount = detail::visitCompileCommandsForHeaders(sourceCompileCommands.commands(), visitor, options, fileSystem);
+        if (!headerCount) {
+            return headerCount.error();
         }
 
-        return tlogFiles;
-    } catch (const fs::filesystem_error& e) {
-        return e;
+        visitedCount += *headerCount;
     }
+
+    return visitedCount;
+}
+
+// the tlogs in one .tlog directory all belong to the same project, each .vcxproj is a project of its own
+[[nodiscard]] auto inSameProject(const fs::path& first, const fs::path& second) -> bool
+{
+    return first.extension() != ".vcxproj" && second.extension() != ".vcxproj" && first.parent_path() == second.parent_path();
+}
+
+[[nodiscard]] auto createCompileCommandsWith(
+    const std::function<Result<std::size_t, std::runtime_error>(const CompileCommandVisitor&)>& visit
+) -> Result<CompileCommandStore, std::runtime_error>
+{
+    CompileCommandStore compileCommands;
+
+    const auto visitedCount = visit([&compileCommands] (const CompileCommand& compileCommand) {
+        compileCommands.add(compileCommand);
+    });
+
+    if (!visitedCount) {
+        return visitedCount.error();
+    }
+
+    return compileCommands;
+}
+} // namespace
+
+auto visitCompileCommands(
+    const fs::path& buildDir,
+    std::span<const fs::path> tlogFiles,
+    const CompileCommandVisitor& visitor,
+    const Options& options,
+    FileSystem& fileSystem
+) -> Result<std::size_t, std::runtime_error>
+{
+    const auto projectInputs = [tlogFiles] (const std::function<bool(std::vector<fs::path>)>& projectVisitor) -> Result<std::size_t, std::runtime_error> {
+        auto projectCount = 0_uz;
+        for (auto projectStart = 0_uz; projectStart < tlogFiles.size();) {
+            auto projectEnd = projectStart + 1_uz;
+            while (projectEnd < tlogFiles.size() && inSameProject(tlogFiles[projectStart], tlogFiles[projectEnd])) {
+                projectEnd++;
+            }
+
+            projectCount++;
+            if (!projectVisitor(std::vector<fs::path>(tlogFiles.begin() + static_cast<std::ptrdiff_t>(projectStart), tlogFiles.begin() + static_cast<std::ptrdiff_t>(projectEnd)))) {
+                break;
+            }
+
+            projectStart = projectEnd;
+        }
+
+        return projectCount;
+    };
+
+    return visitCompileCommandsFrom(buildDir, projectInputs, visitor, options, fileSystem);
+}
+
+auto visitBuildDirCompileCommands(
+    const fs::path& buildDir,
+    BuildInputs inputs,
+    const CompileCommandVisitor& visitor,
+    const Options& options,
+    FileSystem& fileSystem
+) -> Result<std::size_t, std::runtime_error>
+{
+    const auto projectInputs = [&] (const std::function<bool(std::vector<fs::path>)>& projectVisitor) {
+        if (inputs == BuildInputs::Vcxproj) {
+            return detail::visitVcxprojFiles(buildDir, [&projectVisitor] (fs::path vcxprojFile) {
+                return projectVisitor(std::vector<fs::path>{std::move(vcxprojFile)});
+            }, fileSystem);
+        }
+
+        return detail::visitTlogDirectories(buildDir, options.configuration, projectVisitor, fileSystem);
+    };
+
+    return visitCompileCommandsFrom(buildDir, projectInputs, visitor, options, fileSystem);
 }
 
 auto createCompileCommands(
     const fs::path& buildDir,
     std::span<const fs::path> tlogFiles,
-    bool skipHeaders
-) -> Result<std::vector<CompileCommand>, std::runtime_error>
+    const Options& options,
+    FileSystem& fileSystem
+) -> Result<CompileCommandStore, std::runtime_error>
 {
-    std::vector<std::string_view> extensions = {
-        ".C", ".CC", ".CPP", ".CXX", ".M", ".MM"
+    return createCompileCommandsWith([&] (const CompileCommandVisitor& visitor) {
+        return visitCompileCommands(buildDir, tlogFiles, visitor, options, fileSystem);
+    });
+}
+
+auto createBuildDirCompileCommands(
+    const fs::path& buildDir,
+    BuildInputs inputs,
+    const Options& options,
+    FileSystem& fileSystem
+) -> Result<CompileCommandStore, std::runtime_error>
+{
+    return createCompileCommandsWith([&] (const CompileCommandVisitor& visitor) {
+        return visitBuildDirCompileCommands(buildDir, inputs, visitor, options, fileSystem);
+    });
+}
+
+[[nodiscard]] auto addHeaderCompileCommands(
+    CompileCommandStore& compileCommands,
+    const Options& options,
+    FileSystem& fileSystem
+) -> Result<std::size_t, std::runtime_error>
+{
+    // the scan goes back to the source entries while it visits headers, so the headers
+    // can't be added to compileCommands until it's done
+    CompileCommandStore headerCompileCommands;
+    const auto headerCount = detail::visitCompileCommandsForHeaders(compileCommands.commands(), [&headerCompileCommands] (const CompileCommand& compileCommand) {
+        headerCompileCommands.add(compileCommand);
+    }, options, fileSystem);
+
+    if (!headerCount) {
+        return headerCount.error();
+    }
+
+    for (const auto& compileCommand : headerCompileCommands) {
+        compileCommands.add(compileCommand);
+    }
+
+    return *headerCount;
+}
+
+[[nodiscard]] auto writeFileAtomically(
+    const fs::path& path,
+    const std::function<Result<std::size_t, std::runtime_error>(std::ostream&)>& write,
+    std::ios::openmode mode
+) -> Result<std::size_t, std::runtime_error>
+{
+    auto tempPath = path;
+    tempPath += ".tmp";
+
+    auto removeTempFile = [&tempPath] {
+        std::error_code ignored;
+        fs::remove(tempPath, ignored);
     };
 
-    std::vector<CompileCommand> compileCommands;
+    std::ofstream stream{tempPath, mode};
+    if (!stream) {
+        return std::runtime_error{fmt::format("Failed to open {}", tempPath.string())};
+    }
 
-    for (const auto& file : tlogFiles) {
-        log("File: {}\n", file.string());
+    const auto written = write(stream);
+    stream.close();
 
-        std::ifstream inFileStream{file, std::ios::binary};
-        const auto lines = detail::readFileLines(inFileStream);
-        if (!lines) {
-            return lines.error();
+    if (!written) {
+        removeTempFile();
+        return written.error();
+    }
+
+    if (!stream) {
+        removeTempFile();
+        return std::runtime_error{fmt::format("Failed to write {}", tempPath.string())};
+    }
+
+    // anything watching path (like clangd) would reload it for nothing
+    auto unchanged = [&tempPath, &path] {
+        std::error_code error;
+        const auto size = fs::file_size(path, error);
+        if (error || size != fs::file_size(tempPath, error) || error) {
+            return false;
         }
 
-        for (const auto& line : *lines) {
-            if (!line.starts_with("/c")) {
-                continue;
+        std::ifstream oldStream{path, std::ios::binary};
+        std::ifstream newStream{tempPath, std::ios::binary};
+        std::array<char, 64 * 1024> oldBuffer{}, newBuffer{};
+        while (oldStream && newStream) {
+            oldStream.read(oldBuffer.data(), static_cast<std::streamsize>(oldBuffer.size()));
+            newStream.read(newBuffer.data(), static_cast<std::streamsize>(newBuffer.size()));
+            if (oldStream.gcount() != newStream.gcount()
+                || !std::equal(oldBuffer.begin(), oldBuffer.begin() + oldStream.gcount(), newBuffer.begin())) {
+                return false;
             }
+        }
 
-            log("Command: {}\n", line);
+        return oldStream.eof() && newStream.eof();
+    };
 
-            if (std::ranges::none_of(extensions, [&line] (const auto extension) {
-                return line.ends_with(extension);
-            })) {
-                return std::runtime_error{fmt::format("Command did not end with source file: {}", line)};
-            }
-
-            std::string command{"cl.exe "};
-
-            // go from the end of the command until we find the last occurrence of a Windows drive letter and ':'
-            // that will be the start of the full path to the source file
-            std::string targetFile;
-            for (auto i = line.size() - 2_uz; i > 0_uz; i--) {
-                if (std::isalpha(line[i]) && line[i + 1_uz] == ':') {
-                    const auto fileName = line.substr(i);
-
-                    // paths in the tlog files seem to all be converted to all upper case.
-                    if (auto correctCasing = detail::getCorrectCasingForPath(fileName)) {
-                        targetFile = correctCasing->string();
-                        log("Source File: {}\n", targetFile);
-
-                        auto lineFixedCase = line;
-                        lineFixedCase.replace(i, fileName.size(), targetFile);
-                        command.append(lineFixedCase);
-
-                        if (std::ranges::none_of(compileCommands, [&targetFile] (const auto& compileCommand) -> bool {
-                            return compileCommand.file == targetFile;
-                        })) {
-                            compileCommands.push_back(CompileCommand{
-                                .directory = buildDir.string(),
-                                .command = std::move(command),
-                                .file = std::move(targetFile),
-                            });
-                        }
-                    } else {
-                        logWarning("Failed to find source file \"{}\" in command \"{}\": \"{}\"\n", fileName, line, correctCasing.error().what());
-                    }
+    if (unchanged()) {
+        removeTempFile();
+        return *written;
+    }
+
+    // replaces path if it's there, on Windows as well as everywhere else
+    std::error_code error;
+    fs::rename(tempPath, path, error);
+    if (error) {
+        removeTempFile();
+        return std::runtime_error{fmt::format("Failed to replace {}: {}", path.string(), error.message())};
+    }
+
+    return *written;
+}
+
+[[nodiscard]] auto sortCompileCommands(std::span<const CompileCommand> compileCommands) -> std::vector<CompileCommand>
+{
+    // fold each path once rather than in every comparison
+    std::vector<std::pair<std::string, std::size_t>> keys;
+    keys.reserve(compileCommands.size());
+    for (auto i = 0_uz; i < compileCommands.size(); i++) {
+        keys.emplace_back(detail::foldPath(compileCommands[i].file), i);
+    }
+
+    std::ranges::sort(keys, [compileCommands] (const auto& first, const auto& second) {
+        if (first.first != second.first) {
+            return first.first < second.first;
+        }
+
+        const auto& a = compileCommands[first.second];
+        const auto& b = compileCommands[second.second];
+        return std::tie(a.file, a.owner, a.project, a.directory, a.command, first.second)
+            < std::tie(b.file, b.owner, b.project, b.directory, b.command, second.second);
+    });
+
+    std::vector<CompileCommand> sorted;
+    sorted.reserve(compileCommands.size());
+    for (const auto& [folded, index] : keys) {
+        sorted.push_back(compileCommands[index]);
+    }
+
+    return sorted;
+}
+
+auto writeCompileCommandsJson(std::ostream& stream, std::span<const CompileCommand> compileCommands) -> void
+{
+    if (compileCommands.empty()) {
+        stream << "[]";
+        return;
+    }
+
+    stream << "[\n";
+
+    for (auto i = 0_uz; i < compileCommands.size(); i++) {
+        detail::writeCompileCommandJson(stream, compileCommands[i]);
+        stream << (i + 1_uz == compileCommands.size() ? "\n" : ",\n");
+    }
+
+    stream << "]";
+}
+
+auto CompileCommandStore::add(const CompileCommand& compileCommand) -> const CompileCommand&
+{
+    if (compileCommand.directory != m_lastDirectory) {
+        m_lastDirectory = m_arena.intern(compileCommand.directory);
+    }
+
+    if (compileCommand.project != m_lastProject) {
+        m_lastProject = m_arena.intern(compileCommand.project);
+    }
+
+    // the file is normally the end of the command, so it can share the command's copy
+    const auto command = m_arena.intern(compileCommand.command);
+    const auto file = command.ends_with(compileCommand.file)
+        ? command.substr(command.size() - compileCommand.file.size())
+        : m_arena.intern(compileCommand.file);
+
+    return m_commands.emplace_back(CompileCommand{
+        .directory = m_lastDirectory,
+        .command = command,
+        .file = file,
+        .owner = m_arena.intern(compileCommand.owner),
+        .project = m_lastProject,
+    });
+}
+
+auto CompileCommandStore::addInterned(const CompileCommand& compileCommand) -> const CompileCommand&
+{
+    return m_commands.emplace_back(compileCommand);
+}
+
+namespace detail {
+auto visitTlogDirectories(
+    const fs::path& buildDir,
+    std::string_view config,
+    const std::function<bool(std::vector<fs::path>)>& visitor,
+    FileSystem& fileSystem
+) -> Result<std::size_t, std::runtime_error>
+{
+    if (!fileSystem.isDirectory(buildDir)) {
+        return std::runtime_error{fmt::format("{} is not a directory", buildDir.string())};
+    }
+
+    // recursing can cause a stack overflow for very large projects
+    // so do a loop advancing one level through the file tree at a time
+    auto visitedCount = 0_uz;
+    std::vector<fs::path> dirsToCheck{buildDir};
+
+    while (!dirsToCheck.empty()) {
+        COMPDBVS_TRACE_SCOPE_DETAIL("Find tlog files", "{} directories", dirsToCheck.size());
+        std::vector<fs::path> innerDirs;
+
+        for (const auto& dir : dirsToCheck) {
+            auto entries = fileSystem.listDirectory(dir);
+            if (!entries) {
+                return entries.error().toRuntimeError();
+            }
+
+            // directories aren't listed in any particular order, and the order the projects are found in
+            // decides which one a file shared between them goes to
+            std::ranges::sort(*entries, {}, &DirectoryEntry::path);
 
-                    break;
+            // a directory's command tlogs go oldest first, so visitCompileCommands ends up with the newest command for each file
+            std::vector<DirectoryEntry> commandTlogs;
+
+            for (auto& entry : *entries) {
+                if (entry.isDirectory) {
+                    innerDirs.push_back(std::move(entry.path));
+                } else {
+                    const auto parent = entry.path.parent_path().parent_path();
+                    if (parent.filename() == config && isCommandTlog(entry.path.filename().string())) {
+                        commandTlogs.push_back(std::move(entry));
+                    }
                 }
             }
+
+            if (commandTlogs.empty()) {
+                continue;
+            }
+
+            std::ranges::sort(commandTlogs, [] (const DirectoryEntry& first, const DirectoryEntry& second) {
+                return first.lastWriteTime != second.lastWriteTime
+                    ? first.lastWriteTime < second.lastWriteTime
+                    : first.path < second.path;
+            });
+
+            std::vector<fs::path> tlogFiles;
+            tlogFiles.reserve(commandTlogs.size());
+            for (auto& commandTlog : commandTlogs) {
+                tlogFiles.push_back(std::move(commandTlog.path));
+            }
+
+            visitedCount++;
+            if (!visitor(std::move(tlogFiles))) {
+                return visitedCount;
+            }
         }
+
+        dirsToCheck.swap(innerDirs);
     }
 
-    if (!skipHeaders) {
-        logInfo("Sarching for header files\n");
+    return visitedCount;
+}
 
-        std::optional<std::vector<CompileCommand>> additionalCommands;
-        while (true) {
-            auto headersCommands = detail::createCompileCommandsForHeaders(
-                buildDir,
-                additionalCommands ? *additionalCommands : compileCommands,
-                compileCommands
-            );
+auto visitVcxprojFiles(
+    const fs::path& buildDir,
+    const std::function<bool(fs::path)>& visitor,
+    FileSystem& fileSystem
+) -> Result<std::size_t, std::runtime_error>
+{
+    if (!fileSystem.isDirectory(buildDir)) {
+        return std::runtime_error{fmt::format("{} is not a directory", buildDir.string())};
+    }
 
-            if (!headersCommands) {
-                return headersCommands.error();
+    auto visitedCount = 0_uz;
+    std::vector<fs::path> dirsToCheck{buildDir};
+
+    while (!dirsToCheck.empty()) {
+        COMPDBVS_TRACE_SCOPE_DETAIL("Find vcxproj files", "{} directories", dirsToCheck.size());
+        std::vector<fs::path> innerDirs;
+
+        for (const auto& dir : dirsToCheck) {
+            auto entries = fileSystem.listDirectory(dir);
+            if (!entries) {
+                return entries.error().toRuntimeError();
             }
 
-            additionalCommands = std::move(*headersCommands);
-            if (additionalCommands->empty()) {
-                break;
+            std::ranges::sort(*entries, {}, &DirectoryEntry::path);
+
+            for (auto& entry : *entries) {
+                if (entry.isDirectory) {
+                    if (entry.path.filename() != "CMakeFiles") {
+                        innerDirs.push_back(std::move(entry.path));
+                    }
+                } else if (entry.path.extension() == ".vcxproj") {
+                    visitedCount++;
+                    if (!visitor(std::move(entry.path))) {
+                        return visitedCount;
+                    }
+                }
             }
+        }
 
-            compileCommands.insert(
-                compileCommands.end(),
-                additionalCommands->begin(),
-                additionalCommands->end()
-            );
+        dirsToCheck.swap(innerDirs);
+    }
+
+    return visitedCount;
+}
+
+auto writeJsonString(std::ostream& stream, std::string_view string) -> void
+{
+    stream.put('"');
+
+    auto start = 0_uz;
+    for (auto i = 0_uz; i < string.size(); i++) {
+        const auto c = static_cast<unsigned char>(string[i]);
+        if (c != '"' && c != '\\' && c >= 0x20) {
+            continue;
+        }
+
+        stream.write(string.data() + start, static_cast<std::streamsize>(i - start));
+        start = i + 1_uz;
+
+        switch (c) {
+            case '"':
+                stream << "\\\"";
+                break;
+            case '\\':
+                stream << "\\\\";
+                break;
+            case '\b':
+                stream << "\\b";
+                break;
+            case '\f':
+                stream << "\\f";
+                break;
+            case '\n':
+                stream << "\\n";
+                break;
+            case '\r':
+                stream << "\\r";
+                break;
+            case '\t':
+                stream << "\\t";
+                break;
+            default:
+                stream << fmt::format("\\u{:04x}", c);
+                break;
         }
     }
 
-    return compileCommands;
+    stream.write(string.data() + start, static_cast<std::streamsize>(string.size() - start));
+    stream.put('"');
+}
+
+auto writeCompileCommandJson(std::ostream& stream, const CompileCommand& compileCommand) -> void
+{
+    // written by hand rather than through nlohmann::json so the strings
+    // don't all have to be copied into a json object first
+    stream << "    {\n        \"command\": ";
+    writeJsonString(stream, compileCommand.command);
+    stream << ",\n        \"directory\": ";
+    writeJsonString(stream, compileCommand.directory);
+    stream << ",\n        \"file\": ";
+    writeJsonString(stream, compileCommand.file);
+    stream << "\n    }";
+}
+
+[[nodiscard]] auto isCommandTlog(std::string_view fileName) -> bool
+{
+    auto upperCase = std::string{fileName};
+    std::ranges::transform(upperCase, upperCase.begin(), [] (const char c) {
+        return static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    });
+
+    return upperCase.starts_with("CL.") && upperCase.ends_with(".TLOG") && upperCase.find(".COMMAND.") != std::string::npos;
+}
+
+[[nodiscard]] auto findProjectName(const fs::path& tlogFile) -> std::string
+{
+    if (tlogFile.extension() == ".vcxproj") {
+        return tlogFile.stem().string();
+    }
+
+    return tlogFile.parent_path().stem().string();
 }
 
-namespace detail {
 [[nodiscard]] auto getCorrectCasingForPath(
-    const fs::path& filePath
-) -> Result<fs::path, std::runtime_error>
+    const fs::path& filePath,
+    FileSystem& fileSystem
+) -> Result<fs::path, Error>
 {
     // why does std::filesystem not have a function to tell you if a path is a root
     // that works for Windows drive roots?
@@ -201,17 +916,8 @@ namespace detail {
         return it == path.end();
     };
 
-    // why does std::string not have functions to change case?
-    auto toLower = [] (const std::string_view string) -> std::string {
-        std::string res;
-        for (const auto c : string) {
-            res.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
-        }
-        return res;
-    };
-
-    if (!fs::exists(filePath)) {
-        return std::runtime_error{fmt::format("{} did not exist", filePath.string())};
+    if (!fileSystem.exists(filePath)) {
+        return Error{ErrorCode::NotFound, filePath};
     }
 
     if (isDriveRoot(filePath) || !filePath.has_parent_path()) {
@@ -219,29 +925,29 @@ namespace detail {
     }
 
     const auto parent = filePath.parent_path();
-    if (!fs::is_directory(parent)) {
-        return std::runtime_error{fmt::format("Directory {} did not exist", parent.string())};
+    if (!fileSystem.isDirectory(parent)) {
+        return Error{ErrorCode::NotADirectory, parent};
+    }
+
+    const auto entries = fileSystem.listDirectory(parent);
+    if (!entries) {
+        return entries.error();
     }
 
-    for (const auto& entry : fs::directory_iterator{parent}) {
+    const auto fileName = filenameView(filePath);
+    for (const auto& entry : *entries) {
         // need to compare the actual text but ignore case because for some reason 
         // fs::equivalent returns true for 'C:/Users/' and 'C:/Documents and Settings/'
-        if (toLower(entry.path().filename().string()) == toLower(filePath.filename().string())) {
-            if (const auto res = getCorrectCasingForPath(parent)) {
-                return *res / entry.path().filename();
+        if (equalsIgnoreCase(filenameView(entry.path), fileName)) {
+            if (const auto res = getCorrectCasingForPath(parent, fileSystem)) {
+                return *res / entry.path.filename();
             } else {
                 return res.error();
             }
         }
     }
 
-    return std::runtime_error{
-        fmt::format(
-            "Didn't find entry in parent for {} that matched {}", 
-            parent.string(), 
-            filePath.filename().string()
-        )
-    };
+    return Error{ErrorCode::NoMatchingEntry, filePath};
 }
 
 [[nodiscard]] auto getFileEncoding(std::istream& stream) -> FileEncoding
@@ -268,13 +974,14 @@ namespace detail {
         return std::runtime_error{"Invalid file stream"};
     }
 
-    const auto encoding = getFileEncoding(stream);
-
     // TODO: make this more memory efficient
     std::stringstream readStream;
     readStream << stream.rdbuf();
-    const auto contents = readStream.str();
+    return readFileLines(std::string_view{readStream.str()});
+}
 
+[[nodiscard]] auto readFileLines(std::string_view contents) -> std::vector<std::string>
+{
     auto getLines = [] (std::string_view string) {
         std::vector<std::string> lines;
 
@@ -289,17 +996,19 @@ namespace detail {
         return lines;
     };
 
-    if (encoding == FileEncoding::Utf8) {
+    // same as getFileEncoding, but the UTF-16 byte order mark is skipped here rather than by reading past it
+    const auto littleEndian = contents.starts_with("\xFF\xFE");
+    if (!littleEndian && !contents.starts_with("\xFE\xFF")) {
         return getLines(contents);
-    } else {
-        std::string converted;
-        converted.reserve(contents.size() / 2_uz);
-        for (auto i = encoding == FileEncoding::Utf16LittleEndian ? 0_uz : 1_uz; i < contents.size(); i += 2) {
-            converted.push_back(contents[i]);
-        }
+    }
 
-        return getLines(converted);
+    std::string converted;
+    converted.reserve(contents.size() / 2_uz);
+    for (auto i = littleEndian ? 2_uz : 3_uz; i < contents.size(); i += 2) {
+        converted.push_back(contents[i]);
     }
+
+    return getLines(converted);
 }
 
 [[nodiscard]] auto findIncludePaths(
@@ -331,7 +1040,7 @@ namespace detail {
         }
 
         auto includePath = command.substr(start, end == std::string::npos ? command.size() : end - start);
-        log("Found include path {}\n", includePath);
+        COMPDBVS_LOG("Found include path {}\n", includePath);
         includePaths.emplace_back(includePath);
         pos = end + 1_uz;
     }
@@ -339,118 +1048,282 @@ namespace detail {
     return includePaths;
 }
 
-[[nodiscard]] auto createCompileCommandsForHeaders(
-    const fs::path& buildDir,
-    std::span<const CompileCommand> compileCommandsToCheck,
-    std::span<const CompileCommand> allCompileCommands
-) -> Result<std::vector<CompileCommand>, std::runtime_error>
-{
-    std::vector<CompileCommand> headerCompileCommands;
-
-    auto createCompileCommand = [&] (
-        const fs::path& includePath,
-        std::string_view includedFile,
-        std::string_view sourceFile,
-        std::string_view command
-    ) -> std::optional<std::runtime_error> {
-        auto filePath = includePath / includedFile;
-        // because this path is made from an "#include" directive, it might contain "/../"
-        // so normalise it
-        filePath = filePath.lexically_normal();
-        if (!fs::exists(filePath)) {
-            log("Ignoring {} because it does not exist\n", filePath.string());
-            return {};
-        }
-
-        const auto correctCasing = detail::getCorrectCasingForPath(filePath);
-        if (!correctCasing) {
-            return correctCasing.error();
-        }
-
-        auto headerPath = correctCasing->string();
-
-        // need to check for duplicates
-        if (std::ranges::any_of(allCompileCommands, [&headerPath] (const auto& compileCommand) -> bool {
-            return compileCommand.file == headerPath;
-        }) || std::ranges::any_of(headerCompileCommands, [&headerPath] (const auto& compileCommand) -> bool {
-            return compileCommand.file == headerPath;
-        })) {
-            log("Ignoring {} because it has already had an entry in the database created for it\n", headerPath);
-            return {};
+[[nodiscard]] auto findExternalIncludePaths(
+    std::string_view command
+) -> std::vector<fs::path>
+{
+    std::vector<fs::path> externalPaths;
+
+    // MSVC warns about std::getenv not being thread safe
+    auto getEnvironmentVariable = [] (const std::string& name) -> std::optional<std::string> {
+#ifdef _WIN32
+        char* buffer = nullptr;
+        auto size = 0_uz;
+        if (_dupenv_s(&buffer, &size, name.c_str()) != 0 || buffer == nullptr) {
+            return std::nullopt;
         }
 
-        log("Creating compile command for {}\n", headerPath);
-
-        auto headerCommand = std::string{command};
-        const auto fileNamePos = headerCommand.find(sourceFile);
-        headerCommand.replace(fileNamePos, sourceFile.size(), headerPath);
-
-        headerCompileCommands.emplace_back(CompileCommand{
-            .directory = buildDir.string(),
-            .command = std::move(headerCommand),
-            .file = std::move(headerPath),
-        });
+        std::string value{buffer};
+        std::free(buffer);
+        return value;
+#else
+        if (const auto value = std::getenv(name.c_str())) {
+            return value;
+        }
 
-        return {};
+        return std::nullopt;
+#endif
     };
 
-    for (const auto& [directory, command, file] : compileCommandsToCheck) {
-        const auto& sourceFile = file;
-        const auto isObjC = sourceFile.ends_with("m");
+    auto unquote = [] (std::string_view value) -> std::string_view {
+        if (value.size() >= 2_uz && value.front() == '"' && value.back() == '"') {
+            value = value.substr(1_uz, value.size() - 2_uz);
+        }
+        return value;
+    };
 
-        log("Finding included headers for {}\n", sourceFile);
+    auto pos = 0_uz;
+    while (true) {
+        const auto token = nextCommandToken(command, pos);
+        if (token.empty()) {
+            break;
+        }
 
-        std::ifstream inFileStream{sourceFile, std::ios::binary};
-        const auto lines = detail::readFileLines(inFileStream);
-        if (!lines) {
-            return lines.error();
+        const auto flag = findFlag(token);
+        if (flag == nullptr) {
+            continue;
         }
 
-        struct IncludedFile
-        {
-            std::string filePath;
-            bool usesQuotes;
-        };
+        if (flag->name == "/external:I" || flag->name == "/imsvc") {
+            auto value = token.substr(flag->name.size());
+            if (value.empty()) {
+                value = nextCommandToken(command, pos);
+            }
 
-        std::vector<IncludedFile> includedFiles;
+            if (!value.empty()) {
+                COMPDBVS_LOG("Found external include path {}\n", unquote(value));
+                externalPaths.emplace_back(unquote(value));
+            }
+        } else if (flag->name == "/external:env:") {
+            const auto variable = std::string{unquote(token.substr(flag->name.size()))};
+            const auto value = getEnvironmentVariable(variable);
+            if (!value) {
+                continue;
+            }
 
-        // find included files
-        for (const auto& line : *lines) {
-            std::string_view l = line;
-            for (auto i = 0_uz; i < line.size(); i++) {
-                if (line[i] != ' ' && line[i] != '\t') {
-                    l = {line.data() + i};
-                    break;
+            for (const auto path : std::string_view{*value} | std::views::split(';') | std::views::transform([] (const auto s) {
+                return std::string_view{s};
+            })) {
+                if (!path.empty()) {
+                    COMPDBVS_LOG("Found external include path {} from %{}%\n", path, variable);
+                    externalPaths.emplace_back(path);
                 }
             }
+        }
+    }
 
-            if (l.empty() || !l.starts_with("#include") || (isObjC && !l.starts_with("#import"))) {
-                continue;
+    return externalPaths;
+}
+
+[[nodiscard]] auto countFlags(std::string_view command) -> std::size_t
+{
+    auto count = 0_uz;
+    for (auto i = 0_uz; i < command.size(); i++) {
+        if ((command[i] == '/' || command[i] == '-') && (i == 0_uz || command[i - 1_uz] == ' ')) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+[[nodiscard]] auto compareOwnerCandidates(const OwnerCandidate& lhs, const OwnerCandidate& rhs) -> bool
+{
+    // a TU from the same part of the tree as the header is the most likely to have the right context for it,
+    // then prefer the one that includes it most directly, then the cheapest command for clangd to deal with.
+    // the index of the TU makes the choice deterministic when everything else is equal
+    if (lhs.sharedPathComponents != rhs.sharedPathComponents) {
+        return lhs.sharedPathComponents > rhs.sharedPathComponents;
+    }
+
+    if (lhs.depth != rhs.depth) {
+        return lhs.depth < rhs.depth;
+    }
+
+    if (lhs.flagCount != rhs.flagCount) {
+        return lhs.flagCount < rhs.flagCount;
+    }
+
+    if (lhs.commandLength != rhs.commandLength) {
+        return lhs.commandLength < rhs.commandLength;
+    }
+
+    return lhs.sourceIndex < rhs.sourceIndex;
+}
+
+[[nodiscard]] auto visitCompileCommandsForHeaders(
+    std::span<const CompileCommand> sourceCompileCommands,
+    const CompileCommandVisitor& visitor,
+    const Options& options,
+    FileSystem& fileSystem
+) -> Result<std::size_t, std::runtime_error>
+{
+    std::unordered_set<PathKey> sourceFiles;
+    for (const auto& compileCommand : sourceCompileCommands) {
+        sourceFiles.emplace(compileCommand.file);
+    }
+
+    // every TU walks its own include graph, but files are only read once, only scanned once
+    // for each distinct set of /D and /U flags, and each candidate path is only checked on disk once
+    std::unordered_map<std::string, std::vector<std::string>> fileLinesCache;
+    std::unordered_map<std::string, std::vector<IncludedFile>> includedFilesCache;
+    // keyed ignoring case, since the /I paths from the tlogs are upper case and the includes usually aren't
+    std::unordered_map<PathKey, std::optional<std::string>> resolvedPathCache;
+    std::unordered_map<std::string, std::size_t> defineSetIndices;
+
+    // reads every file in files that hasn't been read yet in one batch, see FileSystem::readFiles
+    auto readFiles = [&] (std::span<const std::string> files) -> Result<std::size_t, std::runtime_error> {
+        std::vector<fs::path> unreadFiles;
+        for (const auto& file : files) {
+            if (!fileLinesCache.contains(file)) {
+                unreadFiles.emplace_back(file);
             }
+        }
 
-            auto start = l.starts_with("#include") ? 8_uz : 7_uz; // length of "#include" / "#import"
-            while (start < l.size() && (l[start] == ' ' || l[start] == '\t')) {
-                start++;
+        if (unreadFiles.empty()) {
+            return 0_uz;
+        }
+
+        COMPDBVS_TRACE_SCOPE_DETAIL("Read files", "{} files", unreadFiles.size());
+        const auto contents = fileSystem.readFiles(unreadFiles);
+        for (auto i = 0_uz; i < unreadFiles.size(); i++) {
+            auto file = unreadFiles[i].string();
+            if (!contents[i]) {
+                return std::runtime_error{fmt::format("Failed to open {}", file)};
             }
 
-            if (l[start] == '"') {
-                start++;
-                if (const auto end = l.find('"', start); end != std::string::npos) {
-                    auto includedFile = l.substr(start, end - start);
-                    log("Found included file \"{}\"\n", includedFile);
-                    includedFiles.emplace_back(IncludedFile{std::string{includedFile}, true});
-                }
-            } else if (l[start] == '<') {
-                start++;
-                if (const auto end = l.find('>', start); end != std::string::npos) {
-                    auto includedFile = l.substr(start, end - start);
-                    log("Found included file <{}>\n", includedFile);
-                    includedFiles.emplace_back(IncludedFile{std::string{includedFile}, false});
-                }
+            fileLinesCache.emplace(std::move(file), detail::readFileLines(*contents[i]));
+        }
+
+        return unreadFiles.size();
+    };
+
+    // the file has to have been through readFiles first
+    auto getIncludedFiles = [&] (
+        const std::string& file,
+        const MacroDefinitions& defines,
+        std::size_t defineSetIndex
+    ) -> const std::vector<IncludedFile>* {
+        auto cacheKey = fmt::format("{}|{}", defineSetIndex, file);
+        if (const auto it = includedFilesCache.find(cacheKey); it != includedFilesCache.end()) {
+            return &it->second;
+        }
+
+        COMPDBVS_LOG("Finding included headers for {}\n", file);
+
+        const auto isObjC = file.ends_with("m");
+        const auto [it, inserted] = includedFilesCache.emplace(
+            std::move(cacheKey),
+            findIncludedFiles(fileLinesCache.at(file), defines, isObjC)
+        );
+        return &it->second;
+    };
+
+    // fixes the casing of every path a level of includes could be at in one go, see CasingResolver.
+    // gives back where each of filePaths really is, or nullopt for the ones that don't exist
+    CasingResolver casingResolver{fileSystem};
+    auto resolvePaths = [&] (
+        std::span<const fs::path> filePaths
+    ) -> Result<std::vector<const std::optional<std::string>*>, std::runtime_error> {
+        std::vector<PathKey> keys;
+        keys.reserve(filePaths.size());
+
+        std::vector<fs::path> unresolvedPaths;
+        std::vector<PathKey> unresolvedKeys;
+        std::unordered_set<PathKey> queued;
+
+        for (const auto& filePath : filePaths) {
+            auto& key = keys.emplace_back(filePath.string());
+            if (!resolvedPathCache.contains(key) && queued.insert(key).second) {
+                unresolvedPaths.push_back(filePath);
+                unresolvedKeys.push_back(key);
             }
         }
 
-        log("Finding include paths for {}\n", sourceFile);
+        const auto correctCasings = casingResolver.resolve(unresolvedPaths);
+        for (auto i = 0_uz; i < unresolvedPaths.size(); i++) {
+            // most of these won't exist, which the resolver tells us without allocating an error message
+            std::optional<std::string> resolved;
+            if (const auto& correctCasing = correctCasings[i]) {
+                resolved = correctCasing->string();
+            } else if (correctCasing.error().code() == ErrorCode::NotFound) {
+                COMPDBVS_LOG("Ignoring {} because it does not exist\n", unresolvedPaths[i].string());
+            } else {
+                return correctCasing.error().toRuntimeError();
+            }
+
+            resolvedPathCache.emplace(std::move(unresolvedKeys[i]), std::move(resolved));
+        }
+
+        std::vector<const std::optional<std::string>*> resolvedPaths;
+        resolvedPaths.reserve(keys.size());
+        for (const auto& key : keys) {
+            resolvedPaths.push_back(&resolvedPathCache.at(key));
+        }
+
+        return resolvedPaths;
+    };
+
+    // the parts of the boundary that don't depend on the TU, worked out once per header
+    std::unordered_map<std::string, bool> inProjectCache;
+    auto isInProject = [&] (const std::string& headerPath) -> bool {
+        if (const auto it = inProjectCache.find(headerPath); it != inProjectCache.end()) {
+            return it->second;
+        }
+
+        auto inProject = !options.projectRoot || isPathWithin(headerPath, *options.projectRoot);
+
+        if (inProject && !options.headerIncludeGlobs.empty()) {
+            inProject = std::ranges::any_of(options.headerIncludeGlobs, [&headerPath] (const auto& glob) {
+                return matchesGlob(headerPath, glob);
+            });
+        }
+
+        if (inProject) {
+            inProject = std::ranges::none_of(options.headerExcludeGlobs, [&headerPath] (const auto& glob) {
+                return matchesGlob(headerPath, glob);
+            });
+        }
+
+        inProjectCache.emplace(headerPath, inProject);
+        return inProject;
+    };
+
+    // headers in the order they were first found, and the best TU seen for each so far
+    std::vector<std::string> headers;
+    std::unordered_map<std::string, OwnerCandidate> owners;
+
+    // what got left out because of the limits in options, so it can be reported at the end
+    const auto searchStart = std::chrono::steady_clock::now();
+    auto outOfTime = [&options, searchStart] () -> bool {
+        return options.headerTimeBudget && std::chrono::steady_clock::now() - searchStart >= *options.headerTimeBudget;
+    };
+    // the headers at the depth limit aren't read, so whether they include anything more isn't known. reading them
+    // just to find out would cost the very reads the limit is there to save, so this only says the limit was reached
+    auto sourcesAtDepthLimit = 0_uz;
+    auto droppedHeaders = 0_uz;
+    auto unscannedSources = 0_uz;
+
+    for (auto sourceIndex = 0_uz; sourceIndex < sourceCompileCommands.size(); sourceIndex++) {
+        if (outOfTime()) {
+            unscannedSources = sourceCompileCommands.size() - sourceIndex;
+            break;
+        }
+
+        const auto& [directory, command, sourceFile, owner, project] = sourceCompileCommands[sourceIndex];
+        COMPDBVS_TRACE_SCOPE_DETAIL("Scan includes", "{}", sourceFile);
+
+        COMPDBVS_LOG("Finding include paths for {}\n", sourceFile);
 
         // find this file's include paths
         auto includePaths = findIncludePaths(command);
@@ -458,27 +1331,193 @@ namespace detail {
             return includePaths.error();
         }
 
-        // for each include file, generate a compile command for that file on each include path
-        for (const auto& [fileName, usesQuotes] : includedFiles) {
-            // If the file is included using quotes, search in the source file's directory first
-            // if it's also found on an include path, it will be ignored if it was found on the
-            // source file's relative path first. This mirrors how the preprocessor works.
-            if (usesQuotes) {
-                const auto relativePath = fs::path{sourceFile}.parent_path();
-                if (auto err = createCompileCommand(relativePath, fileName, sourceFile, command)) {
-                    return *err;
+        const auto flagCount = countFlags(command) + includePaths->size();
+
+        // don't even look in /I directories that are external or outside the project,
+        // nothing found in them would be given an entry
+        const auto externalPaths = findExternalIncludePaths(command);
+        auto isExternal = [&externalPaths] (const fs::path& path) -> bool {
+            return std::ranges::any_of(externalPaths, [&path] (const auto& externalPath) {
+                return isPathWithin(path, externalPath);
+            });
+        };
+
+        std::erase_if(*includePaths, [&] (const auto& includePath) {
+            if (isExternal(includePath) || (options.projectRoot && !isPathWithin(includePath, *options.projectRoot))) {
+                COMPDBVS_LOG("Not searching {} for headers because it is outside of the project\n", includePath.string());
+                return true;
+            }
+            return false;
+        });
+
+        const auto defines = findDefines(command);
+        std::vector<std::string> defineSetKey;
+        for (const auto& [name, value] : defines) {
+            defineSetKey.push_back(value ? fmt::format("{}={}", name, *value) : name);
+        }
+        std::ranges::sort(defineSetKey);
+
+        std::string joinedDefineSetKey;
+        for (const auto& define : defineSetKey) {
+            joinedDefineSetKey.append(define).push_back(';');
+        }
+
+        const auto defineSetIndex = defineSetIndices.emplace(std::move(joinedDefineSetKey), defineSetIndices.size()).first->second;
+        const auto sourceDirectory = fs::path{sourceFile}.parent_path();
+
+        std::unordered_set<std::string> visited;
+        std::vector<std::string> filesToCheck{std::string{sourceFile}};
+
+        for (auto depth = 1_uz; !filesToCheck.empty(); depth++) {
+            if (options.maxHeaderDepth && depth > *options.maxHeaderDepth) {
+                sourcesAtDepthLimit++;
+                break;
+            }
+
+            // a source file that was started is finished off a level at a time, so its headers all have the right depth
+            if (depth > 1_uz && outOfTime()) {
+                unscannedSources = sourceCompileCommands.size() - sourceIndex;
+                break;
+            }
+
+            std::vector<std::string> nextFilesToCheck;
+
+            auto addCandidate = [&] (const std::string& headerPath) {
+                if (sourceFiles.contains(PathKey{headerPath})) {
+                    COMPDBVS_LOG("Ignoring {} because it has already had an entry in the database created for it\n", headerPath);
+                    return;
+                }
+
+                if (!visited.insert(headerPath).second) {
+                    return;
+                }
+
+                if (isExternal(headerPath) || !isInProject(headerPath)) {
+                    COMPDBVS_LOG("Ignoring {} because it is outside of the project\n", headerPath);
+                    return;
+                }
+
+                // headers we already have can still find a better owner, but new ones aren't added or followed
+                const auto isNewHeader = !owners.contains(headerPath);
+                if (isNewHeader && options.maxHeaderEntries && headers.size() >= *options.maxHeaderEntries) {
+                    COMPDBVS_LOG("Ignoring {} because the limit of {} header entries was reached\n", headerPath, *options.maxHeaderEntries);
+                    droppedHeaders++;
+                    return;
+                }
+
+                nextFilesToCheck.push_back(headerPath);
+
+                const auto headerDirectory = fs::path{headerPath}.parent_path();
+                const auto [mismatch, _] = std::ranges::mismatch(headerDirectory, sourceDirectory);
+
+                const OwnerCandidate candidate{
+                    .sourceIndex = sourceIndex,
+                    .depth = depth,
+                    .sharedPathComponents = static_cast<std::size_t>(std::distance(headerDirectory.begin(), mismatch)),
+                    .flagCount = flagCount,
+                    .commandLength = command.size(),
+                };
+
+                if (const auto it = owners.find(headerPath); it == owners.end()) {
+                    headers.push_back(headerPath);
+                    owners.emplace(headerPath, candidate);
+                } else if (compareOwnerCandidates(candidate, it->second)) {
+                    it->second = candidate;
+                }
+            };
+
+            // every path this level's includes could be at, in the order the preprocessor would look
+            std::vector<fs::path> candidatePaths;
+
+            if (const auto readCount = readFiles(filesToCheck); !readCount) {
+                return readCount.error();
+            }
+
+            for (const auto& file : filesToCheck) {
+                const auto includedFiles = getIncludedFiles(file, defines, defineSetIndex);
+
+                // for each include file, check for that file on each include path
+                for (const auto& [fileName, usesQuotes] : *includedFiles) {
+                    // If the file is included using quotes, search in the including file's directory first
+                    // if it's also found on an include path, it will be ignored if it was found on the
+                    // including file's relative path first. This mirrors how the preprocessor works.
+                    // because these paths are made from "#include" directives, they might contain "/../" so normalise them
+                    if (usesQuotes) {
+                        candidatePaths.push_back((fs::path{file}.parent_path() / fileName).lexically_normal());
+                    }
+
+                    for (const auto& includePath : *includePaths) {
+                        candidatePaths.push_back((includePath / fileName).lexically_normal());
+                    }
                 }
             }
 
-            for (const auto& includePath : *includePaths) {
-                if (auto err = createCompileCommand(includePath, fileName, sourceFile, command)) {
-                    return *err;
+            const auto resolvedPaths = resolvePaths(candidatePaths);
+            if (!resolvedPaths) {
+                return resolvedPaths.error();
+            }
+
+            for (const auto resolved : *resolvedPaths) {
+                if (*resolved) {
+                    addCandidate(**resolved);
                 }
             }
+
+            filesToCheck.swap(nextFilesToCheck);
         }
+
+        if (unscannedSources != 0_uz) {
+            break;
+        }
+    }
+
+    if (sourcesAtDepthLimit != 0_uz) {
+        logWarning(
+            "Reached the header depth limit of {} in {} source files, anything the headers at that depth include wasn't searched\n",
+            *options.maxHeaderDepth,
+            sourcesAtDepthLimit
+        );
+    }
+
+    if (droppedHeaders != 0_uz) {
+        logWarning("Reached the limit of {} header entries, {} more includes of new headers were left out\n", *options.maxHeaderEntries, droppedHeaders);
+    }
+
+    if (unscannedSources != 0_uz) {
+        logWarning(
+            "Ran out of time after {}ms, {} of {} source files weren't fully searched for headers\n",
+            options.headerTimeBudget->count(),
+            unscannedSources,
+            sourceCompileCommands.size()
+        );
+    }
+
+    COMPDBVS_TRACE_SCOPE_DETAIL("Create header commands", "{} headers", headers.size());
+
+    // every header command is built in the same buffer, the visitor copies it if it wants to keep it
+    std::string headerCommand;
+
+    for (const auto& headerPath : headers) {
+        const auto& source = sourceCompileCommands[owners.at(headerPath).sourceIndex];
+
+        COMPDBVS_LOG("Creating compile command for {} from {}\n", headerPath, source.file);
+
+        // splice the header in where the source file was
+        const auto fileNamePos = source.command.rfind(source.file);
+        const auto before = source.command.substr(0_uz, fileNamePos);
+        const auto after = source.command.substr(fileNamePos + source.file.size());
+        headerCommand.assign(before).append(headerPath).append(after);
+
+        visitor(CompileCommand{
+            .directory = source.directory,
+            .command = headerCommand,
+            .file = std::string_view{headerCommand}.substr(before.size(), headerPath.size()),
+            .owner = source.file,
+            .project = source.project,
+        });
     }
 
-    return headerCompileCommands;
+    return headers.size();
 }
 } // namespace detail
 } // namespace compdbvs
@@ -23,15 +23,21 @@
 #ifndef COMPDB_VS_HPP
 #define COMPDB_VS_HPP
 
+#include "arena.hpp"
+#include "filesystem.hpp"
+#include "log.hpp"
 #include "result.hpp"
 
-#include <fmt/color.h>
-#include <fmt/core.h>
-
+#include <chrono>
 #include <cstddef>
 #include <filesystem>
+#include <functional>
+#include <ios>
+#include <iosfwd>
+#include <optional>
 #include <span>
 #include <stdexcept>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -43,28 +49,230 @@ inline constexpr std::size_t operator""_uz (unsigned long long int value)
 namespace compdbvs {
 namespace fs = std::filesystem;
 
-extern bool g_verbose;
-
+// the strings are views into the StringArena of the CompileCommandStore the command came from,
+// so they're only valid for as long as that store is alive
 struct [[nodiscard]] CompileCommand
 {
-    std::string directory;
-    std::string command;
-    std::string file;
+    std::string_view directory;
+    std::string_view command;
+    std::string_view file;
+    // for header entries, the source file whose command was used, empty for source files
+    std::string_view owner = {};
+    // the MSBuild project the entry came from (the name of its .tlog directory), headers belong to their owner's project
+    std::string_view project = {};
+};
+
+// owns every CompileCommand made in a run and the memory for their strings
+class CompileCommandStore
+{
+public:
+    using const_iterator = std::vector<CompileCommand>::const_iterator;
+
+    // copies the strings of compileCommand into this store's arena
+    auto add(const CompileCommand& compileCommand) -> const CompileCommand&;
+
+    // for commands whose strings were already made with arena(), so nothing needs copying
+    auto addInterned(const CompileCommand& compileCommand) -> const CompileCommand&;
+
+    [[nodiscard]] auto arena() noexcept -> StringArena&
+    {
+        return m_arena;
+    }
+
+    [[nodiscard]] auto commands() const noexcept -> std::span<const CompileCommand>
+    {
+        return m_commands;
+    }
+
+    [[nodiscard]] auto begin() const noexcept -> const_iterator
+    {
+        return m_commands.begin();
+    }
+
+    [[nodiscard]] auto end() const noexcept -> const_iterator
+    {
+        return m_commands.end();
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t
+    {
+        return m_commands.size();
+    }
+
+    [[nodiscard]] auto empty() const noexcept -> bool
+    {
+        return m_commands.empty();
+    }
+
+    [[nodiscard]] auto operator[](std::size_t index) const -> const CompileCommand&
+    {
+        return m_commands[index];
+    }
+
+private:
+    StringArena m_arena;
+    std::vector<CompileCommand> m_commands;
+    // every entry normally has the same directory, and entries from the same project come together,
+    // so only keep one copy of them
+    std::string_view m_lastDirectory;
+    std::string_view m_lastProject;
+};
+
+struct Options
+{
+    // don't add entries for the headers included by the source files
+    bool skipHeaders = false;
+    // strip flags clangd has no use for (outputs, debug info, codegen), see flags.hpp
+    bool minimalCommands = false;
+    // headers outside this directory are never given entries or scanned for more includes
+    std::optional<fs::path> projectRoot = {};
+    // if not empty, headers have to match at least one of these to be given entries or scanned, see detail::matchesGlob
+    std::vector<std::string> headerIncludeGlobs = {};
+    // headers matching any of these are never given entries or scanned
+    std::vector<std::string> headerExcludeGlobs = {};
+    // the configuration whose settings are used when the inputs are .vcxproj files rather than tlogs
+    std::string configuration = "Debug";
+    // includes more than this many levels below a source file aren't followed, 1 means only the headers
+    // a source file includes itself get entries
+    std::optional<std::size_t> maxHeaderDepth = {};
+    // no more headers are given entries once this many have been found
+    std::optional<std::size_t> maxHeaderEntries = {};
+    // the header search stops after this long, the headers found by then still get entries
+    std::optional<std::chrono::milliseconds> headerTimeBudget = {};
 };
 
+// every command tlog (see detail::isCommandTlog) of config under buildDir, with each .tlog directory's tlogs
+// oldest first so that the newest command for a file wins when they're read
 [[nodiscard]] auto findTlogFiles(
     const fs::path& buildDir,
-    std::string_view config
+    std::string_view config,
+    FileSystem& fileSystem = realFileSystem()
+) -> Result<std::vector<fs::path>, std::runtime_error>;
+
+// the .vcxproj files CMake generated in buildDir, for making entries without having to build first.
+// the ones CMake makes under CMakeFiles to check the compiler are left out
+[[nodiscard]] auto findVcxprojFiles(
+    const fs::path& buildDir,
+    FileSystem& fileSystem = realFileSystem()
 ) -> Result<std::vector<fs::path>, std::runtime_error>;
 
+// called with each entry as soon as it's made. the strings are only valid until the visitor returns,
+// so anything it wants to keep has to be copied (CompileCommandStore::add does that)
+using CompileCommandVisitor = std::function<void(const CompileCommand&)>;
+
+// the streaming version of createCompileCommands, for when the entries don't all need to be in memory at once.
+// the tlogs are read in parallel, then source files are visited a project at a time in the order the tlogs were given,
+// with a later tlog's command for a file replacing an earlier one's in the same project. headers are visited once every
+// source file has been scanned since that's when their owners are known. .vcxproj files can be given instead of tlogs,
+// see detail::readVcxprojCommands. returns how many entries were visited
+[[nodiscard]] auto visitCompileCommands(
+    const fs::path& buildDir,
+    std::span<const fs::path> tlogFiles,
+    const CompileCommandVisitor& visitor,
+    const Options& options = {},
+    FileSystem& fileSystem = realFileSystem()
+) -> Result<std::size_t, std::runtime_error>;
+
 [[nodiscard]] auto createCompileCommands(
     const fs::path& buildDir,
     std::span<const fs::path> tlogFiles,
-    bool skipHeaders
-) -> Result<std::vector<CompileCommand>, std::runtime_error>;
+    const Options& options = {},
+    FileSystem& fileSystem = realFileSystem()
+) -> Result<CompileCommandStore, std::runtime_error>;
+
+// what the entries are made from when the build directory is searched for them
+enum class BuildInputs
+{
+    // the command tlogs of options.configuration, see findTlogFiles
+    Tlogs,
+    // the generated .vcxproj files, see findVcxprojFiles
+    Vcxproj,
+};
+
+// findTlogFiles (or findVcxprojFiles) and visitCompileCommands at the same time. each project is parsed
+// as soon as it's found and its source files are visited as soon as it's parsed, rather than waiting
+// for the whole build directory to be searched first. the entries come out the same as they would from
+// calling the two one after the other
+[[nodiscard]] auto visitBuildDirCompileCommands(
+    const fs::path& buildDir,
+    BuildInputs inputs,
+    const CompileCommandVisitor& visitor,
+    const Options& options = {},
+    FileSystem& fileSystem = realFileSystem()
+) -> Result<std::size_t, std::runtime_error>;
+
+[[nodiscard]] auto createBuildDirCompileCommands(
+    const fs::path& buildDir,
+    BuildInputs inputs,
+    const Options& options = {},
+    FileSystem& fileSystem = realFileSystem()
+) -> Result<CompileCommandStore, std::runtime_error>;
+
+// gives entries to the headers reachable from the source file entries in compileCommands (see
+// detail::visitCompileCommandsForHeaders) and adds them after the source files. this is the second half of
+// createCompileCommands, for when the source files were made with skipHeaders so they could be used first.
+// returns how many header entries were added
+[[nodiscard]] auto addHeaderCompileCommands(
+    CompileCommandStore& compileCommands,
+    const Options& options = {},
+    FileSystem& fileSystem = realFileSystem()
+) -> Result<std::size_t, std::runtime_error>;
+
+// the entries in their canonical order, by file path compared the way Windows does (see detail::foldPath) and then
+// by every other field, so the same entries always come out the same however they were found.
+// the strings still belong to whatever owns compileCommands
+[[nodiscard]] auto sortCompileCommands(std::span<const CompileCommand> compileCommands) -> std::vector<CompileCommand>;
+
+// writes the entries as a JSON compilation database, laid out the same way nlohmann::json does with std::setw(4)
+auto writeCompileCommandsJson(std::ostream& stream, std::span<const CompileCommand> compileCommands) -> void;
+
+// calls write with a stream to a temporary file next to path and then renames it over path, so anything
+// reading path (like clangd) sees either the old file or all of the new one, and a failed write leaves the old one alone.
+// if the new file is byte for byte the same as the old one, the old one is left where it is so its modification time
+// doesn't change. returns what write returned
+[[nodiscard]] auto writeFileAtomically(
+    const fs::path& path,
+    const std::function<Result<std::size_t, std::runtime_error>(std::ostream&)>& write,
+    std::ios::openmode mode = std::ios::out
+) -> Result<std::size_t, std::runtime_error>;
 
 namespace detail {
-[[nodiscard]] auto getCorrectCasingForPath(const fs::path& filePath) -> Result<fs::path, std::runtime_error>;
+// calls visitor with the command tlogs of each .tlog directory under buildDir, sorted the way findTlogFiles
+// gives them, as soon as the directory has been listed. stops if visitor returns false.
+// returns how many directories had tlogs
+[[nodiscard]] auto visitTlogDirectories(
+    const fs::path& buildDir,
+    std::string_view config,
+    const std::function<bool(std::vector<fs::path>)>& visitor,
+    FileSystem& fileSystem = realFileSystem()
+) -> Result<std::size_t, std::runtime_error>;
+
+// calls visitor with each .vcxproj file findVcxprojFiles would give, as soon as it's found.
+// stops if visitor returns false. returns how many were found
+[[nodiscard]] auto visitVcxprojFiles(
+    const fs::path& buildDir,
+    const std::function<bool(fs::path)>& visitor,
+    FileSystem& fileSystem = realFileSystem()
+) -> Result<std::size_t, std::runtime_error>;
+
+// writes string as a quoted, escaped JSON string
+auto writeJsonString(std::ostream& stream, std::string_view string) -> void;
+
+// writes one element of the array written by writeCompileCommandsJson, indented but without a trailing comma or newline
+auto writeCompileCommandJson(std::ostream& stream, const CompileCommand& compileCommand) -> void;
+
+// CL.command.1.tlog, and the other command tlogs MSBuild writes next to it for incremental and multi-process
+// builds, such as CL.command.2.tlog and CL.1234.command.1.tlog. the CL.read/CL.write tlogs aren't commands
+[[nodiscard]] auto isCommandTlog(std::string_view fileName) -> bool;
+
+// the project a tlog file belongs to, build/foo.dir/Debug/foo.tlog/CL.command.1.tlog gives foo,
+// and build/foo.vcxproj gives foo too
+[[nodiscard]] auto findProjectName(const fs::path& tlogFile) -> std::string;
+
+[[nodiscard]] auto getCorrectCasingForPath(
+    const fs::path& filePath,
+    FileSystem& fileSystem = realFileSystem()
+) -> Result<fs::path, Error>;
 
 // slightly naive not to include other encodings,
 // but like realistically what else would there be
@@ -78,43 +286,40 @@ enum class FileEncoding
 
 [[nodiscard]] auto getFileEncoding(std::istream& stream) -> FileEncoding;
 [[nodiscard]] auto readFileLines(std::istream& stream) -> Result<std::vector<std::string>, std::runtime_error>;
+// the same for a file that has already been read, the byte order mark decides the encoding like getFileEncoding does
+[[nodiscard]] auto readFileLines(std::string_view contents) -> std::vector<std::string>;
 [[nodiscard]] auto findIncludePaths(std::string_view command) -> Result<std::vector<fs::path>, std::runtime_error>;
 
-[[nodiscard]] auto createCompileCommandsForHeaders(
-    const fs::path& buildDir,
-    std::span<const CompileCommand> compileCommandsToCheck,
-    std::span<const CompileCommand> allCompileCommands
-) -> Result<std::vector<CompileCommand>, std::runtime_error>;
-} // namespace detail
+// the directories given by /external:I, /imsvc and /external:env:<VAR> (split on ';'),
+// headers in these belong to someone else so we don't give them entries
+[[nodiscard]] auto findExternalIncludePaths(std::string_view command) -> std::vector<fs::path>;
 
-template<typename... Ts>
-inline auto log(fmt::format_string<Ts...> message, Ts&&... formatArgs) -> void
+// a source file that reaches a header through its includes, and how expensive it would be to use its command for that header
+struct OwnerCandidate
 {
-    if (g_verbose) {
-        fmt::print(message, std::forward<Ts>(formatArgs)...);
-    }
-}
+    std::size_t sourceIndex;
+    std::size_t depth;
+    std::size_t sharedPathComponents;
+    std::size_t flagCount;
+    std::size_t commandLength;
+};
 
-template<typename... Ts>
-inline auto logInfo(fmt::format_string<Ts...> message, Ts&&... formatArgs) -> void
-{
-    fmt::print(fmt::emphasis::bold | fmt::fg(fmt::color::green), "INFO: ");
-    fmt::print(message, std::forward<Ts>(formatArgs)...);
-}
+[[nodiscard]] auto countFlags(std::string_view command) -> std::size_t;
 
-template<typename... Ts>
-inline auto logWarning(fmt::format_string<Ts...> message, Ts&&... formatArgs) -> void
-{
-    fmt::print(fmt::emphasis::bold | fmt::fg(fmt::color::yellow), "WARNING: ");
-    fmt::print(message, std::forward<Ts>(formatArgs)...);
-}
+// true if lhs would be a better owner for a header than rhs
+[[nodiscard]] auto compareOwnerCandidates(const OwnerCandidate& lhs, const OwnerCandidate& rhs) -> bool;
 
-template<typename... Ts>
-inline auto logError(fmt::format_string<Ts...> message, Ts&&... formatArgs) -> void
-{
-    fmt::print(stderr, fmt::emphasis::bold | fmt::fg(fmt::color::red), "ERROR: ");
-    fmt::print(stderr, message, std::forward<Ts>(formatArgs)...);
-}
+// every header reachable from a source file gets an entry, using the command
+// of the cheapest source file that reaches it (see compareOwnerCandidates).
+// the search stops early when it runs into one of the limits in options, with a warning saying what was left out.
+// returns how many header entries were visited
+[[nodiscard]] auto visitCompileCommandsForHeaders(
+    std::span<const CompileCommand> sourceCompileCommands,
+    const CompileCommandVisitor& visitor,
+    const Options& options = {},
+    FileSystem& fileSystem = realFileSystem()
+) -> Result<std::size_t, std::runtime_error>;
+} // namespace detail
 } // namespace compdbvs
 
 #endif // #ifndef COMPDB_VS_HPP
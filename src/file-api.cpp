@@ -0,0 +1,313 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "file-api.hpp"
+#include "flags.hpp"
+#include "paths.hpp"
+#include "trace.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <optional>
+#include <unordered_set>
+
+namespace compdbvs {
+namespace {
+[[nodiscard]] auto readJsonFile(const fs::path& path, FileSystem& fileSystem) -> Result<nlohmann::json, std::runtime_error>
+{
+    const auto stream = fileSystem.openFile(path);
+    if (!stream) {
+        return std::runtime_error{fmt::format("Failed to open {}", path.string())};
+    }
+
+    auto json = nlohmann::json::parse(*stream, nullptr, false);
+    if (json.is_discarded()) {
+        return std::runtime_error{fmt::format("Failed to parse {}", path.string())};
+    }
+
+    return json;
+}
+
+[[nodiscard]] auto missingReplyError(const fs::path& buildDir) -> std::runtime_error
+{
+    return std::runtime_error{fmt::format(
+        "There's no CMake File API codemodel in {}, configure the project again so CMake writes one",
+        buildDir.string()
+    )};
+}
+} // namespace
+
+[[nodiscard]] auto writeFileApiQuery(const fs::path& buildDir) -> Result<bool, std::runtime_error>
+{
+    const auto queryDir = buildDir / ".cmake" / "api" / "v1" / "query" / detail::g_fileApiClientName;
+    const auto queryFile = queryDir / "codemodel-v2";
+
+    std::error_code error;
+    if (fs::exists(queryFile, error)) {
+        return false;
+    }
+
+    fs::create_directories(queryDir, error);
+    if (error) {
+        return std::runtime_error{fmt::format("Failed to create {}: {}", queryDir.string(), error.message())};
+    }
+
+    // the query is just an empty file, its name is what CMake looks at
+    if (!std::ofstream{queryFile}) {
+        return std::runtime_error{fmt::format("Failed to write {}", queryFile.string())};
+    }
+
+    return true;
+}
+
+auto visitFileApiCompileCommands(
+    const fs::path& buildDir,
+    std::string_view config,
+    const CompileCommandVisitor& visitor,
+    const Options& options,
+    FileSystem& fileSystem
+) -> Result<std::size_t, std::runtime_error>
+{
+    const auto replyDir = buildDir / ".cmake" / "api" / "v1" / "reply";
+    if (!fileSystem.isDirectory(replyDir)) {
+        return missingReplyError(buildDir);
+    }
+
+    auto entries = fileSystem.listDirectory(replyDir);
+    if (!entries) {
+        return entries.error().toRuntimeError();
+    }
+
+    // the names of the index files have the time they were written in them, so the newest one sorts last
+    std::optional<fs::path> indexFile;
+    for (auto& entry : *entries) {
+        const auto fileName = entry.path.filename().string();
+        if (!entry.isDirectory && fileName.starts_with("index-") && fileName.ends_with(".json")
+            && (!indexFile || fileName > indexFile->filename().string())) {
+            indexFile = std::move(entry.path);
+        }
+    }
+
+    if (!indexFile) {
+        return missingReplyError(buildDir);
+    }
+
+    CompileCommandStore sourceCompileCommands;
+    std::unordered_set<detail::PathKey> sourceFiles;
+    auto& arena = sourceCompileCommands.arena();
+    const auto directory = arena.intern(buildDir.string());
+
+    // nlohmann::json throws if anything isn't where or what it should be, which means CMake wrote something we don't understand
+    try {
+        COMPDBVS_TRACE_SCOPE_DETAIL("Read codemodel", "{}", indexFile->string());
+
+        const auto index = readJsonFile(*indexFile, fileSystem);
+        if (!index) {
+            return index.error();
+        }
+
+        const auto& objects = index->at("objects");
+        const auto codemodelObject = std::ranges::find_if(objects, [] (const nlohmann::json& object) {
+            return object.at("kind") == "codemodel" && object.at("version").at("major") == 2;
+        });
+
+        if (codemodelObject == objects.end()) {
+            return missingReplyError(buildDir);
+        }
+
+        const auto codemodel = readJsonFile(replyDir / codemodelObject->at("jsonFile").get<std::string>(), fileSystem);
+        if (!codemodel) {
+            return codemodel.error();
+        }
+
+        const auto sourceDir = fs::path{codemodel->at("paths").at("source").get<std::string>()};
+
+        // the names are whatever was in CMAKE_CONFIGURATION_TYPES, but MSBuild doesn't care about case so we don't either
+        const auto& configurations = codemodel->at("configurations");
+        const auto configuration = std::ranges::find_if(configurations, [config] (const nlohmann::json& candidate) {
+            return std::ranges::equal(candidate.at("name").get<std::string>(), config, [] (const char a, const char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+            });
+        });
+
+        if (configuration == configurations.end()) {
+            std::string names;
+            for (const auto& candidate : configurations) {
+                names.append(names.empty() ? "" : ", ");
+                names.append(candidate.at("name").get<std::string>());
+            }
+
+            return std::runtime_error{fmt::format("The CMake File API codemodel has no configuration {}, it has {}", config, names)};
+        }
+
+        for (const auto& target : configuration->at("targets")) {
+            const auto targetName = target.at("name").get<std::string>();
+            COMPDBVS_TRACE_SCOPE_DETAIL("Read target", "{}", targetName);
+            COMPDBVS_LOG("Target: {}\n", targetName);
+
+            const auto targetJson = readJsonFile(replyDir / target.at("jsonFile").get<std::string>(), fileSystem);
+            if (!targetJson) {
+                return targetJson.error();
+            }
+
+            const auto project = arena.intern(targetName);
+
+            // every source file in a compile group has the same flags, so they only need putting together once
+            std::vector<std::string> groupFlags;
+            for (const auto& compileGroup : targetJson->value("compileGroups", nlohmann::json::array())) {
+                std::string flags = "/c ";
+                for (const auto& fragment : compileGroup.value("compileCommandFragments", nlohmann::json::array())) {
+                    flags.append(fragment.at("fragment").get<std::string>());
+                    flags.push_back(' ');
+                }
+
+                if (compileGroup.contains("languageStandard") && flags.find("/std:") == std::string::npos && flags.find("-std:") == std::string::npos) {
+                    const auto standardFlag = detail::findStandardFlag(
+                        compileGroup.at("language").get<std::string>(),
+                        compileGroup.at("languageStandard").at("standard").get<std::string>()
+                    );
+
+                    if (!standardFlag.empty()) {
+                        flags.append(standardFlag);
+                        flags.push_back(' ');
+                    }
+                }
+
+                for (const auto& include : compileGroup.value("includes", nlohmann::json::array())) {
+                    const auto isSystem = include.value("isSystem", false);
+                    detail::appendCommandArgument(flags, isSystem ? "/external:I" : "/I", include.at("path").get<std::string>());
+                }
+
+                for (const auto& define : compileGroup.value("defines", nlohmann::json::array())) {
+                    detail::appendCommandArgument(flags, "/D", define.at("define").get<std::string>());
+                }
+
+                if (options.minimalCommands) {
+                    flags = detail::minimiseCommand(flags);
+                    flags.push_back(' ');
+                }
+
+                groupFlags.push_back(std::move(flags));
+            }
+
+            for (const auto& source : targetJson->value("sources", nlohmann::json::array())) {
+                // headers and anything else that isn't compiled aren't in a compile group
+                if (!source.contains("compileGroupIndex")) {
+                    continue;
+                }
+
+                const auto groupIndex = source.at("compileGroupIndex").get<std::size_t>();
+                if (groupIndex >= groupFlags.size()) {
+                    return std::runtime_error{fmt::format("Target {} has a source in compile group {}, but only has {}", targetName, groupIndex, groupFlags.size())};
+                }
+
+                // relative paths are relative to the top level source directory
+                const auto sourcePath = source.at("path").get<std::string>();
+                const auto path = detail::isAbsoluteWindowsPath(sourcePath) ? fs::path{sourcePath} : sourceDir / sourcePath;
+
+                const auto targetFile = path.lexically_normal().make_preferred().string();
+                COMPDBVS_LOG("Source File: {}\n", targetFile);
+
+                if (!sourceFiles.emplace(targetFile).second) {
+                    continue;
+                }
+
+                const auto command = arena.concat({"cl.exe ", groupFlags[groupIndex], targetFile});
+                const auto& compileCommand = sourceCompileCommands.addInterned(CompileCommand{
+                    .directory = directory,
+                    .command = command,
+                    .file = command.substr(command.size() - targetFile.size()),
+                    .project = project,
+                });
+
+                visitor(compileCommand);
+            }
+        }
+    } catch (const nlohmann::json::exception& exception) {
+        return std::runtime_error{fmt::format("Failed to read the CMake File API reply: {}", exception.what())};
+    }
+
+    auto visitedCount = sourceCompileCommands.size();
+
+    if (!options.skipHeaders) {
+        logInfo("Sarching for header files\n");
+
+        const auto headerCount = detail::visitCompileCommandsForHeaders(sourceCompileCommands.commands(), visitor, options, fileSystem);
+        if (!headerCount) {
+            return headerCount.error();
+        }
+
+        visitedCount += *headerCount;
+    }
+
+    return visitedCount;
+}
+
+auto createFileApiCompileCommands(
+    const fs::path& buildDir,
+    std::string_view config,
+    const Options& options,
+    FileSystem& fileSystem
+) -> Result<CompileCommandStore, std::runtime_error>
+{
+    CompileCommandStore compileCommands;
+
+    const auto visitedCount = visitFileApiCompileCommands(buildDir, config, [&compileCommands] (const CompileCommand& compileCommand) {
+        compileCommands.add(compileCommand);
+    }, options, fileSystem);
+
+    if (!visitedCount) {
+        return visitedCount.error();
+    }
+
+    return compileCommands;
+}
+
+namespace detail {
+[[nodiscard]] auto findStandardFlag(std::string_view language, std::string_view standard) -> std::string_view
+{
+    if (language == "CXX") {
+        // cl.exe has nothing older than C++14
+        if (standard == "98" || standard == "11" || standard == "14") {
+            return "/std:c++14";
+        } else if (standard == "17") {
+            return "/std:c++17";
+        } else if (standard == "20") {
+            return "/std:c++20";
+        } else {
+            return "/std:c++latest";
+        }
+    } else if (language == "C") {
+        if (standard == "11") {
+            return "/std:c11";
+        } else if (standard == "17") {
+            return "/std:c17";
+        }
+    }
+
+    return {};
+}
+} // namespace detail
+} // namespace compdbvs
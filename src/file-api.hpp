@@ -0,0 +1,67 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_FILE_API_HPP
+#define COMPDBVS_FILE_API_HPP
+
+#include "compdb-vs.hpp"
+
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+
+// reading the build settings from CMake's File API (https://cmake.org/cmake/help/latest/manual/cmake-file-api.7.html)
+// rather than the build logs. the codemodel-v2 reply has the include directories, defines and flags of every
+// source file in every configuration, with paths already in the right case, so nothing needs building first
+// and one configure is enough for every config
+namespace compdbvs {
+// asks CMake for the codemodel the next time the project is configured.
+// returns true if the query wasn't there before, meaning any reply that's there now wasn't made for us
+[[nodiscard]] auto writeFileApiQuery(const fs::path& buildDir) -> Result<bool, std::runtime_error>;
+
+// makes an entry for every source file in every target of config from the newest codemodel reply in buildDir,
+// headers are then visited the same way as they are for the tlogs. returns how many entries were visited
+[[nodiscard]] auto visitFileApiCompileCommands(
+    const fs::path& buildDir,
+    std::string_view config,
+    const CompileCommandVisitor& visitor,
+    const Options& options = {},
+    FileSystem& fileSystem = realFileSystem()
+) -> Result<std::size_t, std::runtime_error>;
+
+[[nodiscard]] auto createFileApiCompileCommands(
+    const fs::path& buildDir,
+    std::string_view config,
+    const Options& options = {},
+    FileSystem& fileSystem = realFileSystem()
+) -> Result<CompileCommandStore, std::runtime_error>;
+
+namespace detail {
+inline constexpr std::string_view g_fileApiClientName = "client-compdb-vs";
+
+// the flag cl.exe needs for a compile group's languageStandard, CMake leaves it out of the fragments
+// for the Visual Studio generators since it goes in the .vcxproj as LanguageStandard instead
+[[nodiscard]] auto findStandardFlag(std::string_view language, std::string_view standard) -> std::string_view;
+} // namespace detail
+} // namespace compdbvs
+
+#endif // #ifndef COMPDBVS_FILE_API_HPP
@@ -0,0 +1,273 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "filesystem.hpp"
+#include "paths.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+namespace compdbvs {
+namespace fs = std::filesystem;
+
+[[nodiscard]] auto FileSystem::stats() const noexcept -> FileSystemStats
+{
+    return FileSystemStats{
+        .existsCount = m_existsCount.load(std::memory_order_relaxed),
+        .isDirectoryCount = m_isDirectoryCount.load(std::memory_order_relaxed),
+        .listDirectoryCount = m_listDirectoryCount.load(std::memory_order_relaxed),
+        .openFileCount = m_openFileCount.load(std::memory_order_relaxed),
+    };
+}
+
+auto FileSystem::resetStats() noexcept -> void
+{
+    m_existsCount.store(0, std::memory_order_relaxed);
+    m_isDirectoryCount.store(0, std::memory_order_relaxed);
+    m_listDirectoryCount.store(0, std::memory_order_relaxed);
+    m_openFileCount.store(0, std::memory_order_relaxed);
+}
+
+[[nodiscard]] auto FileSystem::doReadFiles(std::span<const fs::path> paths) -> std::vector<std::optional<std::string>>
+{
+    std::vector<std::optional<std::string>> contents;
+    contents.reserve(paths.size());
+
+    for (const auto& path : paths) {
+        const auto stream = doOpenFile(path);
+        if (stream == nullptr) {
+            contents.emplace_back();
+            continue;
+        }
+
+        contents.emplace_back(std::string{std::istreambuf_iterator<char>{*stream}, std::istreambuf_iterator<char>{}});
+    }
+
+    return contents;
+}
+
+[[nodiscard]] auto RealFileSystem::doExists(const fs::path& path) -> bool
+{
+    std::error_code errorCode;
+    return fs::exists(path, errorCode);
+}
+
+[[nodiscard]] auto RealFileSystem::doIsDirectory(const fs::path& path) -> bool
+{
+    std::error_code errorCode;
+    return fs::is_directory(path, errorCode);
+}
+
+[[nodiscard]] auto RealFileSystem::doListDirectory(const fs::path& path) -> Result<std::vector<DirectoryEntry>, Error>
+{
+    std::error_code errorCode;
+    fs::directory_iterator directoryIterator{path, errorCode};
+    if (errorCode) {
+        return Error{ErrorCode::Filesystem, path, errorCode};
+    }
+
+    std::vector<DirectoryEntry> entries;
+    for (const auto end = fs::directory_iterator{}; directoryIterator != end; directoryIterator.increment(errorCode)) {
+        if (errorCode) {
+            return Error{ErrorCode::Filesystem, path, errorCode};
+        }
+
+        // the directory entry already knows these on Windows, so they don't cost another syscall
+        const auto isDirectory = directoryIterator->is_directory(errorCode);
+        const auto lastWriteTime = isDirectory ? fs::file_time_type{} : directoryIterator->last_write_time(errorCode);
+        entries.push_back(DirectoryEntry{directoryIterator->path(), isDirectory, lastWriteTime});
+    }
+
+    if (errorCode) {
+        return Error{ErrorCode::Filesystem, path, errorCode};
+    }
+
+    return entries;
+}
+
+[[nodiscard]] auto RealFileSystem::doOpenFile(const fs::path& path) -> std::unique_ptr<std::istream>
+{
+    auto stream = std::make_unique<std::ifstream>(path, std::ios::binary);
+    if (!stream->is_open()) {
+        return nullptr;
+    }
+
+    return stream;
+}
+
+[[nodiscard]] auto RealFileSystem::doReadFiles(std::span<const fs::path> paths) -> std::vector<std::optional<std::string>>
+{
+    std::vector<std::optional<std::string>> contents(paths.size());
+
+    auto readFile = [&paths, &contents] (std::size_t i) {
+        std::ifstream stream{paths[i], std::ios::binary | std::ios::ate};
+        if (!stream.is_open()) {
+            return;
+        }
+
+        const auto size = stream.tellg();
+        if (size < 0) {
+            return;
+        }
+
+        std::string fileContents(static_cast<std::size_t>(size), '\0');
+        stream.seekg(0);
+        stream.read(fileContents.data(), size);
+        // the file can change size between the seek and the read
+        fileContents.resize(static_cast<std::size_t>(stream.gcount()));
+        contents[i] = std::move(fileContents);
+    };
+
+    // the calling thread reads too, so it counts as one of the threads for the cores
+    const auto maxThreadCount = std::size_t{std::max(std::thread::hardware_concurrency(), 1u)} - 1;
+    const auto wantedThreadCount = paths.size() < detail::g_minParallelReadCount
+        ? std::size_t{0}
+        : std::min(maxThreadCount, paths.size() - 1);
+
+    auto threadCount = std::size_t{0};
+    auto running = m_readThreadCount.load();
+    do {
+        threadCount = std::min(wantedThreadCount, running < maxThreadCount ? maxThreadCount - running : 0);
+    } while (threadCount > 0 && !m_readThreadCount.compare_exchange_weak(running, running + threadCount));
+
+    if (threadCount == 0) {
+        for (auto i = std::size_t{0}; i < paths.size(); i++) {
+            readFile(i);
+        }
+        return contents;
+    }
+
+    // each thread takes the next file that hasn't been started, so one slow file doesn't hold up the rest
+    std::atomic<std::size_t> next = 0;
+    auto worker = [&next, &paths, &readFile] {
+        for (auto i = next.fetch_add(1); i < paths.size(); i = next.fetch_add(1)) {
+            readFile(i);
+        }
+    };
+
+    {
+        std::vector<std::jthread> threads;
+        for (auto i = std::size_t{0}; i < threadCount; i++) {
+            threads.emplace_back(worker);
+        }
+
+        worker();
+    }
+
+    m_readThreadCount.fetch_sub(threadCount);
+    return contents;
+}
+
+[[nodiscard]] auto realFileSystem() -> FileSystem&
+{
+    static RealFileSystem fileSystem;
+    return fileSystem;
+}
+
+auto InMemoryFileSystem::addFile(std::string_view path, std::string contents) -> void
+{
+    const auto key = addNode(path, false);
+    auto& node = m_nodes.at(key);
+    node.contents = std::move(contents);
+    m_lastWriteTime += fs::file_time_type::duration{1};
+    node.lastWriteTime = m_lastWriteTime;
+}
+
+auto InMemoryFileSystem::addDirectory(std::string_view path) -> void
+{
+    static_cast<void>(addNode(path, true));
+}
+
+auto InMemoryFileSystem::addNode(std::string_view path, bool isDirectory) -> detail::PathKey
+{
+    std::string name{path};
+    std::ranges::replace(name, '\\', '/');
+    while (name.size() > 1 && name.back() == '/') {
+        name.pop_back();
+    }
+
+    detail::PathKey key{name};
+    if (const auto it = m_nodes.find(key); it != m_nodes.end()) {
+        it->second.isDirectory = isDirectory;
+        return key;
+    }
+
+    m_nodes.emplace(key, Node{.name = name, .isDirectory = isDirectory, .contents = {}, .lastWriteTime = {}, .children = {}});
+
+    if (const auto separator = name.rfind('/'); separator != std::string::npos && separator > 0) {
+        const auto parentKey = addNode(std::string_view{name}.substr(0, separator), true);
+        m_nodes.at(parentKey).children.push_back(key);
+    }
+
+    return key;
+}
+
+[[nodiscard]] auto InMemoryFileSystem::findNode(const fs::path& path) const -> const Node*
+{
+    const auto it = m_nodes.find(detail::PathKey{path.lexically_normal().string()});
+    return it == m_nodes.end() ? nullptr : &it->second;
+}
+
+[[nodiscard]] auto InMemoryFileSystem::doExists(const fs::path& path) -> bool
+{
+    return findNode(path) != nullptr;
+}
+
+[[nodiscard]] auto InMemoryFileSystem::doIsDirectory(const fs::path& path) -> bool
+{
+    const auto node = findNode(path);
+    return node != nullptr && node->isDirectory;
+}
+
+[[nodiscard]] auto InMemoryFileSystem::doListDirectory(const fs::path& path) -> Result<std::vector<DirectoryEntry>, Error>
+{
+    const auto node = findNode(path);
+    if (node == nullptr || !node->isDirectory) {
+        return Error{ErrorCode::NotADirectory, path};
+    }
+
+    std::vector<DirectoryEntry> entries;
+    entries.reserve(node->children.size());
+
+    for (const auto& childKey : node->children) {
+        const auto& child = m_nodes.at(childKey);
+        entries.push_back(DirectoryEntry{path / child.name.substr(child.name.rfind('/') + 1), child.isDirectory, child.lastWriteTime});
+    }
+
+    return entries;
+}
+
+[[nodiscard]] auto InMemoryFileSystem::doOpenFile(const fs::path& path) -> std::unique_ptr<std::istream>
+{
+    const auto node = findNode(path);
+    if (node == nullptr || node->isDirectory) {
+        return nullptr;
+    }
+
+    return std::make_unique<std::istringstream>(node->contents, std::ios::binary);
+}
+} // namespace compdbvs
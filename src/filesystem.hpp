@@ -0,0 +1,189 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_FILESYSTEM_HPP
+#define COMPDBVS_FILESYSTEM_HPP
+
+#include "paths.hpp"
+#include "result.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace compdbvs {
+struct DirectoryEntry
+{
+    std::filesystem::path path;
+    bool isDirectory;
+    // only meaningful for files
+    std::filesystem::file_time_type lastWriteTime = {};
+};
+
+// how many times each operation was asked for, which for the real disk is roughly how many syscalls were made
+struct FileSystemStats
+{
+    std::uint64_t existsCount;
+    std::uint64_t isDirectoryCount;
+    std::uint64_t listDirectoryCount;
+    std::uint64_t openFileCount;
+};
+
+// everything finding tlogs, reading files and resolving paths needs from the disk,
+// so that the whole thing can run against an in-memory tree instead
+class FileSystem
+{
+public:
+    FileSystem() = default;
+    FileSystem(const FileSystem&) = delete;
+    FileSystem(FileSystem&&) = delete;
+    FileSystem& operator=(const FileSystem&) = delete;
+    FileSystem& operator=(FileSystem&&) = delete;
+    virtual ~FileSystem() = default;
+
+    [[nodiscard]] auto exists(const std::filesystem::path& path) -> bool
+    {
+        m_existsCount.fetch_add(1, std::memory_order_relaxed);
+        return doExists(path);
+    }
+
+    [[nodiscard]] auto isDirectory(const std::filesystem::path& path) -> bool
+    {
+        m_isDirectoryCount.fetch_add(1, std::memory_order_relaxed);
+        return doIsDirectory(path);
+    }
+
+    // the entries' paths are path joined with the entry's name as it is on disk
+    [[nodiscard]] auto listDirectory(const std::filesystem::path& path) -> Result<std::vector<DirectoryEntry>, Error>
+    {
+        m_listDirectoryCount.fetch_add(1, std::memory_order_relaxed);
+        return doListDirectory(path);
+    }
+
+    // opened in binary mode, nullptr if the file couldn't be opened
+    [[nodiscard]] auto openFile(const std::filesystem::path& path) -> std::unique_ptr<std::istream>
+    {
+        m_openFileCount.fetch_add(1, std::memory_order_relaxed);
+        return doOpenFile(path);
+    }
+
+    // the whole contents of each file, or nullopt for the ones that couldn't be opened.
+    // this is for when a lot of files are wanted at once, an implementation can have all of them in flight together
+    [[nodiscard]] auto readFiles(std::span<const std::filesystem::path> paths) -> std::vector<std::optional<std::string>>
+    {
+        m_openFileCount.fetch_add(paths.size(), std::memory_order_relaxed);
+        return doReadFiles(paths);
+    }
+
+    [[nodiscard]] auto stats() const noexcept -> FileSystemStats;
+    auto resetStats() noexcept -> void;
+
+protected:
+    [[nodiscard]] virtual auto doExists(const std::filesystem::path& path) -> bool = 0;
+    [[nodiscard]] virtual auto doIsDirectory(const std::filesystem::path& path) -> bool = 0;
+    [[nodiscard]] virtual auto doListDirectory(const std::filesystem::path& path) -> Result<std::vector<DirectoryEntry>, Error> = 0;
+    [[nodiscard]] virtual auto doOpenFile(const std::filesystem::path& path) -> std::unique_ptr<std::istream> = 0;
+    // reads the files one after the other through doOpenFile
+    [[nodiscard]] virtual auto doReadFiles(std::span<const std::filesystem::path> paths) -> std::vector<std::optional<std::string>>;
+
+private:
+    std::atomic<std::uint64_t> m_existsCount = 0;
+    std::atomic<std::uint64_t> m_isDirectoryCount = 0;
+    std::atomic<std::uint64_t> m_listDirectoryCount = 0;
+    std::atomic<std::uint64_t> m_openFileCount = 0;
+};
+
+// std::filesystem and std::ifstream, without exceptions
+class RealFileSystem final : public FileSystem
+{
+protected:
+    [[nodiscard]] auto doExists(const std::filesystem::path& path) -> bool override;
+    [[nodiscard]] auto doIsDirectory(const std::filesystem::path& path) -> bool override;
+    [[nodiscard]] auto doListDirectory(const std::filesystem::path& path) -> Result<std::vector<DirectoryEntry>, Error> override;
+    [[nodiscard]] auto doOpenFile(const std::filesystem::path& path) -> std::unique_ptr<std::istream> override;
+    // big batches are spread over a thread per core, since opening a file on Windows costs far more
+    // than reading a small one and the opens can overlap. each file is read with one call at its full size
+    [[nodiscard]] auto doReadFiles(std::span<const std::filesystem::path> paths) -> std::vector<std::optional<std::string>> override;
+
+private:
+    // the threads started by doReadFiles that are still reading. callers can already be running in parallel
+    // (the tlog parse workers each read their own project's tlogs), so every call shares one thread per core
+    // between them rather than each starting that many, and reads on its own thread once they're all taken
+    std::atomic<std::size_t> m_readThreadCount = 0;
+};
+
+namespace detail {
+// batches smaller than this are read on the calling thread, starting threads would cost more than it saves
+inline constexpr std::size_t g_minParallelReadCount = 8;
+} // namespace detail
+
+// the one everything uses unless it's given another
+[[nodiscard]] auto realFileSystem() -> FileSystem&;
+
+// a tree that behaves like an NTFS drive whatever the platform: names keep the case they were added with
+// but are looked up ignoring case, and either separator can be used. use forward slashes ("C:/foo/bar.cpp")
+// in tests that need to run on Linux, since std::filesystem::path only splits on them there
+class InMemoryFileSystem final : public FileSystem
+{
+public:
+    // adds the file and any directories above it that aren't there yet, replacing the file if it is.
+    // each file added counts as written after the one before it
+    auto addFile(std::string_view path, std::string contents) -> void;
+    auto addDirectory(std::string_view path) -> void;
+
+protected:
+    [[nodiscard]] auto doExists(const std::filesystem::path& path) -> bool override;
+    [[nodiscard]] auto doIsDirectory(const std::filesystem::path& path) -> bool override;
+    [[nodiscard]] auto doListDirectory(const std::filesystem::path& path) -> Result<std::vector<DirectoryEntry>, Error> override;
+    [[nodiscard]] auto doOpenFile(const std::filesystem::path& path) -> std::unique_ptr<std::istream> override;
+
+private:
+    struct Node
+    {
+        // as it was added, with forward slashes
+        std::string name;
+        bool isDirectory;
+        std::string contents;
+        std::filesystem::file_time_type lastWriteTime;
+        // keys of the nodes in this directory
+        std::vector<detail::PathKey> children;
+    };
+
+    // returns the key of the node
+    auto addNode(std::string_view path, bool isDirectory) -> detail::PathKey;
+
+    [[nodiscard]] auto findNode(const std::filesystem::path& path) const -> const Node*;
+
+    std::unordered_map<detail::PathKey, Node> m_nodes;
+    std::filesystem::file_time_type m_lastWriteTime = {};
+};
+} // namespace compdbvs
+
+#endif // #ifndef COMPDBVS_FILESYSTEM_HPP
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "flags.hpp"
+
+#include <cctype>
+
+namespace compdbvs::detail {
+[[nodiscard]] auto nextCommandToken(std::string_view command, std::size_t& pos) -> std::string_view
+{
+    // split on whitespace outside of quotes, following the Windows command line rules
+    // for backslashes before a quote, so /D "FOO=\"bar baz\"" stays as one argument
+    while (pos < command.size() && std::isspace(static_cast<unsigned char>(command[pos]))) {
+        pos++;
+    }
+
+    const auto start = pos;
+    auto inQuotes = false;
+    auto backslashes = std::size_t{0};
+
+    while (pos < command.size()) {
+        const auto c = command[pos];
+        if (c == '\\') {
+            backslashes++;
+        } else {
+            if (c == '"' && backslashes % 2 == 0) {
+                inQuotes = !inQuotes;
+            } else if (!inQuotes && std::isspace(static_cast<unsigned char>(c))) {
+                break;
+            }
+
+            backslashes = 0;
+        }
+
+        pos++;
+    }
+
+    return command.substr(start, pos - start);
+}
+
+auto appendCommandArgument(std::string& command, std::string_view flag, std::string_view value) -> void
+{
+    command.append(flag);
+
+    if (value.find_first_of(" \t\"") == std::string_view::npos) {
+        command.append(value);
+    } else {
+        // backslashes only need doubling when they come before a quote
+        command.push_back('"');
+        auto backslashes = std::size_t{0};
+        for (const auto c : value) {
+            if (c == '\\') {
+                backslashes++;
+            } else {
+                if (c == '"') {
+                    command.append(backslashes + 1, '\\');
+                }
+                backslashes = 0;
+            }
+            command.push_back(c);
+        }
+        command.append(backslashes, '\\');
+        command.push_back('"');
+    }
+
+    command.push_back(' ');
+}
+
+[[nodiscard]] auto minimiseCommand(std::string_view command) -> std::string
+{
+    std::string result;
+    result.reserve(command.size());
+
+    auto append = [&result] (std::string_view part) {
+        if (!result.empty()) {
+            result.push_back(' ');
+        }
+        result.append(part);
+    };
+
+    auto pos = std::size_t{0};
+    while (true) {
+        const auto token = nextCommandToken(command, pos);
+        if (token.empty()) {
+            break;
+        }
+
+        const auto flag = findFlag(token);
+        if (flag == nullptr || flag->action == FlagAction::Keep) {
+            append(token);
+            continue;
+        }
+
+        // the value of a separate argument belongs with the flag, so it goes wherever the flag goes
+        const auto hasSeparateValue = flag->argument == FlagArgument::JoinedOrSeparate && token.size() == flag->name.size();
+
+        if (flag->action == FlagAction::Drop) {
+            if (hasSeparateValue) {
+                static_cast<void>(nextCommandToken(command, pos));
+            }
+            continue;
+        }
+
+        std::string rewritten{flag->rewrite};
+        rewritten.append(token.substr(flag->name.size()));
+        append(rewritten);
+    }
+
+    return result;
+}
+} // namespace compdbvs::detail
@@ -0,0 +1,268 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_FLAGS_HPP
+#define COMPDBVS_FLAGS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace compdbvs::detail {
+enum class FlagAction
+{
+    Keep,
+    Drop,
+    Rewrite,
+};
+
+enum class FlagArgument
+{
+    // the token has to match the flag exactly, eg /FS
+    None,
+    // the value is glued onto the flag, eg /Fo"foo.obj"
+    Joined,
+    // the value is either glued on or is the next token, eg /I path
+    JoinedOrSeparate,
+};
+
+struct FlagInfo
+{
+    std::string_view name;
+    FlagAction action;
+    FlagArgument argument;
+    std::string_view rewrite = {};
+};
+
+// cl.exe flags we know about and what to do with them in --minimal-commands mode.
+// anything not in here is kept as is, so this only needs to list things clangd doesn't care about,
+// plus the common flags that must be kept so that a shorter drop entry can't swallow them (eg /FI vs /Fi).
+// flags are case sensitive, and cl.exe accepts '-' in place of '/', which the lookup handles.
+inline constexpr std::array g_flagTable = {
+    // outputs and bookkeeping, clangd never writes anything
+    FlagInfo{"/Fa", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/FA", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Fd", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Fe", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Fi", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Fm", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Fo", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Fp", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/FR", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Fr", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/FS", FlagAction::Drop, FlagArgument::None},
+    FlagInfo{"/FC", FlagAction::Drop, FlagArgument::None},
+    FlagInfo{"/nologo", FlagAction::Drop, FlagArgument::None},
+    FlagInfo{"/errorReport:", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/diagnostics:", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/MP", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Gm", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Yc", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Yu", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/bigobj", FlagAction::Drop, FlagArgument::None},
+
+    // debug info and code generation, these don't change what the parser sees
+    FlagInfo{"/Zi", FlagAction::Drop, FlagArgument::None},
+    FlagInfo{"/ZI", FlagAction::Drop, FlagArgument::None},
+    FlagInfo{"/Z7", FlagAction::Drop, FlagArgument::None},
+    FlagInfo{"/JMC", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Ob", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Oi", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Oy", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/GS", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/GL", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Gy", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Gd", FlagAction::Drop, FlagArgument::None},
+    FlagInfo{"/RTC", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/sdl", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/guard:", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/Qspectre", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/analyze", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/external:W", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/external:templates", FlagAction::Drop, FlagArgument::Joined},
+    FlagInfo{"/experimental:external", FlagAction::Drop, FlagArgument::None},
+
+    // older clangd doesn't know /external:I, but /imsvc has always meant the same thing to clang-cl
+    FlagInfo{"/external:I", FlagAction::Rewrite, FlagArgument::JoinedOrSeparate, "/imsvc"},
+
+    // things that affect parsing
+    FlagInfo{"/c", FlagAction::Keep, FlagArgument::None},
+    FlagInfo{"/D", FlagAction::Keep, FlagArgument::JoinedOrSeparate},
+    FlagInfo{"/U", FlagAction::Keep, FlagArgument::JoinedOrSeparate},
+    FlagInfo{"/I", FlagAction::Keep, FlagArgument::JoinedOrSeparate},
+    FlagInfo{"/FI", FlagAction::Keep, FlagArgument::JoinedOrSeparate},
+    FlagInfo{"/imsvc", FlagAction::Keep, FlagArgument::JoinedOrSeparate},
+    FlagInfo{"/external:env:", FlagAction::Keep, FlagArgument::Joined},
+    FlagInfo{"/std:", FlagAction::Keep, FlagArgument::Joined},
+    FlagInfo{"/Zc:", FlagAction::Keep, FlagArgument::Joined},
+    FlagInfo{"/EH", FlagAction::Keep, FlagArgument::Joined},
+    FlagInfo{"/GR", FlagAction::Keep, FlagArgument::Joined},
+    FlagInfo{"/MD", FlagAction::Keep, FlagArgument::Joined},
+    FlagInfo{"/MT", FlagAction::Keep, FlagArgument::Joined},
+    FlagInfo{"/O", FlagAction::Keep, FlagArgument::Joined},
+    FlagInfo{"/W", FlagAction::Keep, FlagArgument::Joined},
+    FlagInfo{"/TP", FlagAction::Keep, FlagArgument::None},
+    FlagInfo{"/TC", FlagAction::Keep, FlagArgument::None},
+    FlagInfo{"/fp:", FlagAction::Keep, FlagArgument::Joined},
+    FlagInfo{"/arch:", FlagAction::Keep, FlagArgument::Joined},
+    FlagInfo{"/permissive", FlagAction::Keep, FlagArgument::Joined},
+    FlagInfo{"/utf-8", FlagAction::Keep, FlagArgument::None},
+    FlagInfo{"/openmp", FlagAction::Keep, FlagArgument::Joined},
+};
+
+// FNV-1a, with a seed mixed in so we can search for one that gives no collisions,
+// and the leading '-' treated as '/' since cl.exe accepts either
+[[nodiscard]] constexpr auto hashFlag(std::string_view name, std::uint32_t seed) -> std::uint32_t
+{
+    auto hash = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (auto i = std::size_t{0}; i < name.size(); i++) {
+        const auto c = i == 0 && name[i] == '-' ? '/' : name[i];
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+inline constexpr std::size_t g_flagTableSlots = 512;
+static_assert(g_flagTable.size() < 255, "Flag table indices need to fit in a byte");
+
+[[nodiscard]] constexpr auto findFlagTableSeed() -> std::uint32_t
+{
+    for (auto seed = std::uint32_t{0}; seed < 1000u; seed++) {
+        std::array<bool, g_flagTableSlots> used{};
+        auto collided = false;
+        for (const auto& flag : g_flagTable) {
+            auto& slot = used[hashFlag(flag.name, seed) % g_flagTableSlots];
+            if (slot) {
+                collided = true;
+                break;
+            }
+            slot = true;
+        }
+
+        if (!collided) {
+            return seed;
+        }
+    }
+
+    return ~std::uint32_t{0};
+}
+
+inline constexpr auto g_flagTableSeed = findFlagTableSeed();
+static_assert(g_flagTableSeed != ~std::uint32_t{0}, "Couldn't find a perfect hash seed for the flag table, increase g_flagTableSlots");
+
+// slot -> index into g_flagTable + 1, 0 meaning empty
+inline constexpr auto g_flagTableSlotIndices = [] {
+    std::array<std::uint8_t, g_flagTableSlots> slots{};
+    for (auto i = std::size_t{0}; i < g_flagTable.size(); i++) {
+        slots[hashFlag(g_flagTable[i].name, g_flagTableSeed) % g_flagTableSlots] = static_cast<std::uint8_t>(i + 1);
+    }
+    return slots;
+}();
+
+// every distinct flag name length, longest first, so the longest matching flag wins (eg /Ob before /O)
+inline constexpr auto g_flagTableLengths = [] {
+    std::array<std::size_t, g_flagTable.size()> lengths{};
+    auto count = std::size_t{0};
+    for (const auto& flag : g_flagTable) {
+        auto seen = false;
+        for (auto i = std::size_t{0}; i < count; i++) {
+            seen = seen || lengths[i] == flag.name.size();
+        }
+
+        if (!seen) {
+            lengths[count++] = flag.name.size();
+        }
+    }
+
+    for (auto i = std::size_t{0}; i < count; i++) {
+        for (auto j = i + 1; j < count; j++) {
+            if (lengths[j] > lengths[i]) {
+                const auto tmp = lengths[i];
+                lengths[i] = lengths[j];
+                lengths[j] = tmp;
+            }
+        }
+    }
+
+    return std::pair{lengths, count};
+}();
+
+[[nodiscard]] constexpr auto findFlag(std::string_view token) -> const FlagInfo*
+{
+    if (token.size() < 2 || (token[0] != '/' && token[0] != '-')) {
+        return nullptr;
+    }
+
+    const auto& [lengths, count] = g_flagTableLengths;
+    for (auto i = std::size_t{0}; i < count; i++) {
+        const auto length = lengths[i];
+        if (length > token.size()) {
+            continue;
+        }
+
+        const auto prefix = token.substr(0, length);
+        const auto index = g_flagTableSlotIndices[hashFlag(prefix, g_flagTableSeed) % g_flagTableSlots];
+        if (index == 0) {
+            continue;
+        }
+
+        const auto& flag = g_flagTable[index - 1];
+        if (prefix.substr(1) != flag.name.substr(1)) {
+            continue;
+        }
+
+        if (flag.argument == FlagArgument::None && token.size() != length) {
+            continue;
+        }
+
+        return &flag;
+    }
+
+    return nullptr;
+}
+
+static_assert(findFlag("/Fo\"FMT.DIR\\RELEASE\\\\\"") != nullptr && findFlag("/Fo\"\"")->action == FlagAction::Drop);
+static_assert(findFlag("/Ob2")->action == FlagAction::Drop);
+static_assert(findFlag("/O2")->action == FlagAction::Keep);
+static_assert(findFlag("/FI\"pch.h\"")->action == FlagAction::Keep);
+static_assert(findFlag("-FS")->action == FlagAction::Drop);
+static_assert(findFlag("/FSfoo") == nullptr);
+static_assert(findFlag("C:\\foo.cpp") == nullptr);
+
+// returns the argument starting at or after pos and moves pos past it, or an empty view at the end of the command.
+// quotes are kept in the returned argument
+[[nodiscard]] auto nextCommandToken(std::string_view command, std::size_t& pos) -> std::string_view;
+
+// appends flag followed by value and then a space, quoting value if it needs it so that
+// nextCommandToken splits it back out as one argument
+auto appendCommandArgument(std::string& command, std::string_view flag, std::string_view value) -> void;
+
+// removes/rewrites flags in a cl.exe command line according to g_flagTable,
+// quoted arguments are kept intact
+[[nodiscard]] auto minimiseCommand(std::string_view command) -> std::string;
+} // namespace compdbvs::detail
+
+#endif // #ifndef COMPDBVS_FLAGS_HPP
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "log.hpp"
+
+#include <cstdio>
+#include <mutex>
+
+namespace compdbvs {
+bool g_verbose = false;
+
+namespace {
+std::mutex s_outputMutex;
+
+// once this much verbose output has built up in a thread, write it out
+constexpr std::size_t s_verboseFlushSize = 16 * 1024;
+
+auto write(std::FILE* file, std::string_view text) -> void
+{
+    if (text.empty()) {
+        return;
+    }
+
+    const std::lock_guard lock{s_outputMutex};
+    fmt::print(file, "{}", text);
+}
+
+struct ThreadLogBuffers
+{
+    ThreadLogBuffers() = default;
+    ThreadLogBuffers(const ThreadLogBuffers&) = delete;
+    ThreadLogBuffers(ThreadLogBuffers&&) = delete;
+    ThreadLogBuffers& operator=(const ThreadLogBuffers&) = delete;
+    ThreadLogBuffers& operator=(ThreadLogBuffers&&) = delete;
+
+    // don't lose anything a worker thread logged right before it finished
+    ~ThreadLogBuffers()
+    {
+        write(stdout, {pending.data(), pending.size()});
+    }
+
+    // the message currently being formatted
+    fmt::memory_buffer message;
+    // verbose messages that haven't been written yet
+    fmt::memory_buffer pending;
+};
+
+[[nodiscard]] auto threadLogBuffers() -> ThreadLogBuffers&
+{
+    thread_local ThreadLogBuffers buffers;
+    return buffers;
+}
+} // namespace
+
+namespace detail {
+[[nodiscard]] auto threadLogBuffer() -> fmt::memory_buffer&
+{
+    return threadLogBuffers().message;
+}
+
+auto submitLog(LogLevel level) -> void
+{
+    auto& buffers = threadLogBuffers();
+    const std::string_view message{buffers.message.data(), buffers.message.size()};
+
+    if (level == LogLevel::Verbose) {
+        buffers.pending.append(message);
+        buffers.message.clear();
+
+        if (buffers.pending.size() >= s_verboseFlushSize) {
+            flushLogs();
+        }
+
+        return;
+    }
+
+    // keep this thread's verbose output in order with what comes after it
+    flushLogs();
+    write(level == LogLevel::Error ? stderr : stdout, message);
+    buffers.message.clear();
+}
+} // namespace detail
+
+auto flushLogs() -> void
+{
+    auto& pending = threadLogBuffers().pending;
+    write(stdout, {pending.data(), pending.size()});
+    pending.clear();
+}
+} // namespace compdbvs
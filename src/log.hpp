@@ -0,0 +1,101 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_LOG_HPP
+#define COMPDBVS_LOG_HPP
+
+#include <fmt/color.h>
+#include <fmt/core.h>
+
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+// use this rather than calling compdbvs::log directly on hot paths,
+// the arguments aren't even evaluated unless verbose mode is on
+#define COMPDBVS_LOG(...)                   \
+    do {                                    \
+        if (::compdbvs::g_verbose) {        \
+            ::compdbvs::log(__VA_ARGS__);   \
+        }                                   \
+    } while (false)
+
+namespace compdbvs {
+extern bool g_verbose;
+
+enum class LogLevel
+{
+    Verbose,
+    Info,
+    Warning,
+    Error,
+};
+
+namespace detail {
+// each thread formats into its own buffer, so threads don't wait on each other to format.
+// verbose messages stay in that buffer until it fills up or something more important is logged,
+// everything else is written straight away. the actual write is the only part done under a lock
+[[nodiscard]] auto threadLogBuffer() -> fmt::memory_buffer&;
+auto submitLog(LogLevel level) -> void;
+} // namespace detail
+
+// writes out anything still sitting in this thread's buffer
+auto flushLogs() -> void;
+
+template<typename... Ts>
+inline auto log(fmt::format_string<Ts...> message, Ts&&... formatArgs) -> void
+{
+    if (g_verbose) {
+        fmt::format_to(std::back_inserter(detail::threadLogBuffer()), message, std::forward<Ts>(formatArgs)...);
+        detail::submitLog(LogLevel::Verbose);
+    }
+}
+
+template<typename... Ts>
+inline auto logInfo(fmt::format_string<Ts...> message, Ts&&... formatArgs) -> void
+{
+    auto& buffer = detail::threadLogBuffer();
+    fmt::format_to(std::back_inserter(buffer), fmt::emphasis::bold | fmt::fg(fmt::color::green), "INFO: ");
+    fmt::format_to(std::back_inserter(buffer), message, std::forward<Ts>(formatArgs)...);
+    detail::submitLog(LogLevel::Info);
+}
+
+template<typename... Ts>
+inline auto logWarning(fmt::format_string<Ts...> message, Ts&&... formatArgs) -> void
+{
+    auto& buffer = detail::threadLogBuffer();
+    fmt::format_to(std::back_inserter(buffer), fmt::emphasis::bold | fmt::fg(fmt::color::yellow), "WARNING: ");
+    fmt::format_to(std::back_inserter(buffer), message, std::forward<Ts>(formatArgs)...);
+    detail::submitLog(LogLevel::Warning);
+}
+
+template<typename... Ts>
+inline auto logError(fmt::format_string<Ts...> message, Ts&&... formatArgs) -> void
+{
+    auto& buffer = detail::threadLogBuffer();
+    fmt::format_to(std::back_inserter(buffer), fmt::emphasis::bold | fmt::fg(fmt::color::red), "ERROR: ");
+    fmt::format_to(std::back_inserter(buffer), message, std::forward<Ts>(formatArgs)...);
+    detail::submitLog(LogLevel::Error);
+}
+} // namespace compdbvs
+
+#endif // #ifndef COMPDBVS_LOG_HPP
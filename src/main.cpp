@@ -20,12 +20,19 @@
  * Generate a compilation database based on Visual Studio build files
 */
 
+#include "binary-index.hpp"
 #include "compdb-vs.hpp"
+#include "file-api.hpp"
+#include "memory.hpp"
+#include "shards.hpp"
+#include "trace.hpp"
 
-#include <nlohmann/json.hpp>
-
+#include <charconv>
 #include <chrono>
+#include <cstring>
 #include <fstream>
+#include <optional>
+#include <vector>
 
 #define COMPDB_VS_MAJOR_VERSION 1
 #define COMPDB_VS_MINOR_VERSION 0
@@ -43,9 +50,35 @@ static auto help() -> void
     fmt::print("    --config/-c <config>        Specify the build config you want to generate a compilation database for (Debug, Release etc) [default: Debug]\n");
     fmt::print("    --build-dir/-b <dir-name>   Specify the build directory relative to the current working directory to look for VS build files and generate the compilation database [default: build]\n");
     fmt::print("    --skip-headers/-sh          Skip adding header files to the compilation database\n");
+    fmt::print("    --minimal-commands/-mc      Strip flags that clangd doesn't need (output paths, debug info, codegen) from the commands\n");
+    fmt::print("    --project-root/-pr <dir>    Only add entries for and search through headers inside this directory, relative to the current working directory\n");
+    fmt::print("    --header-include/-hi <glob> Only add entries for and search through headers matching this glob, can be given more than once\n");
+    fmt::print("    --header-exclude/-he <glob> Never add entries for or search through headers matching this glob, can be given more than once\n");
+    fmt::print("    --header-depth/-hd <n>      Only follow includes this many levels below each source file, 1 means only the headers the source files include themselves\n");
+    fmt::print("    --max-header-entries/-mh <n> Stop adding header entries once there are this many\n");
+    fmt::print("    --time-budget/-tb <ms>      Stop searching for headers after this many milliseconds, the headers found by then still get entries\n");
+    fmt::print("    --from-vcxproj/-fv          Make the entries from the generated .vcxproj files instead of the build logs, so nothing needs to be built first\n");
+    fmt::print("    --file-api/-fa              Make the entries from CMake's File API codemodel, which has every config after one configure and needs nothing built\n");
+    fmt::print("    --sharded/-sd               Keep each project's entries in build/compdb-vs-shards and only rewrite the ones that changed, compile_commands.json is made by merging them\n");
+    fmt::print("    --binary-index/-bi          Also write compile_commands.idx, a sorted index of the entries that can be memory mapped and searched without parsing\n");
+    fmt::print("    --progressive/-pg           Write compile_commands.json as soon as the source files have entries, then again once the headers have been found\n");
+    fmt::print("    --trace/-t <file>           Record how long each part of the run takes to this file, which can be opened in Perfetto or chrome://tracing\n");
+    fmt::print("    --stats/-st                 Print how long each phase took and how much memory it used\n");
     fmt::print("    --verbose/-v                Enable verbose mode\n");
 }
 
+// a whole non-negative number, with nothing after it
+[[nodiscard]] static auto parseCount(std::string_view arg) -> std::optional<std::size_t>
+{
+    auto count = 0_uz;
+    const auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), count);
+    if (error != std::errc{} || end != arg.data() + arg.size()) {
+        return std::nullopt;
+    }
+
+    return count;
+}
+
 auto main(int argc, const char* argv[]) -> int
 {
     namespace fs = std::filesystem;
@@ -55,7 +88,14 @@ auto main(int argc, const char* argv[]) -> int
     std::string config = "Debug";
     std::string buildDir = "build";
     const auto numArgs = static_cast<std::size_t>(argc);
-    auto skipHeaders = false;
+    compdbvs::Options options;
+    auto fromVcxproj = false;
+    auto fileApi = false;
+    auto sharded = false;
+    auto binaryIndex = false;
+    auto progressiveOutput = false;
+    std::optional<fs::path> tracePath;
+    auto printStats = false;
 
     for (auto i = 1_uz; i < numArgs; i++) {
         const auto arg = argv[i];
@@ -75,7 +115,89 @@ auto main(int argc, const char* argv[]) -> int
 
             buildDir = argv[++i];
         } else if (std::strcmp(arg, "--skip-headers") == 0 || std::strcmp(arg, "-sh") == 0) {
-            skipHeaders = true;
+            options.skipHeaders = true;
+        } else if (std::strcmp(arg, "--minimal-commands") == 0 || std::strcmp(arg, "-mc") == 0) {
+            options.minimalCommands = true;
+        } else if (std::strcmp(arg, "--project-root") == 0 || std::strcmp(arg, "-pr") == 0) {
+            if (i == numArgs - 1_uz) {
+                compdbvs::logError("Expected value for project-root\n");
+                return 1;
+            }
+
+            options.projectRoot = fs::absolute(argv[++i]);
+        } else if (std::strcmp(arg, "--header-include") == 0 || std::strcmp(arg, "-hi") == 0) {
+            if (i == numArgs - 1_uz) {
+                compdbvs::logError("Expected value for header-include\n");
+                return 1;
+            }
+
+            options.headerIncludeGlobs.emplace_back(argv[++i]);
+        } else if (std::strcmp(arg, "--header-exclude") == 0 || std::strcmp(arg, "-he") == 0) {
+            if (i == numArgs - 1_uz) {
+                compdbvs::logError("Expected value for header-exclude\n");
+                return 1;
+            }
+
+            options.headerExcludeGlobs.emplace_back(argv[++i]);
+        } else if (std::strcmp(arg, "--header-depth") == 0 || std::strcmp(arg, "-hd") == 0) {
+            if (i == numArgs - 1_uz) {
+                compdbvs::logError("Expected value for header-depth\n");
+                return 1;
+            }
+
+            options.maxHeaderDepth = parseCount(argv[++i]);
+            if (!options.maxHeaderDepth || *options.maxHeaderDepth == 0_uz) {
+                compdbvs::logError("header-depth must be a whole number above 0, got '{}'\n", argv[i]);
+                return 1;
+            }
+        } else if (std::strcmp(arg, "--max-header-entries") == 0 || std::strcmp(arg, "-mh") == 0) {
+            if (i == numArgs - 1_uz) {
+                compdbvs::logError("Expected value for max-header-entries\n");
+                return 1;
+            }
+
+            options.maxHeaderEntries = parseCount(argv[++i]);
+            if (!options.maxHeaderEntries) {
+                compdbvs::logError("max-header-entries must be a whole number, got '{}'\n", argv[i]);
+                return 1;
+            }
+        } else if (std::strcmp(arg, "--time-budget") == 0 || std::strcmp(arg, "-tb") == 0) {
+            if (i == numArgs - 1_uz) {
+                compdbvs::logError("Expected value for time-budget\n");
+                return 1;
+            }
+
+            const auto milliseconds = parseCount(argv[++i]);
+            if (!milliseconds) {
+                compdbvs::logError("time-budget must be a whole number of milliseconds, got '{}'\n", argv[i]);
+                return 1;
+            }
+
+            options.headerTimeBudget = std::chrono::milliseconds{static_cast<std::chrono::milliseconds::rep>(*milliseconds)};
+        } else if (std::strcmp(arg, "--from-vcxproj") == 0 || std::strcmp(arg, "-fv") == 0) {
+            fromVcxproj = true;
+        } else if (std::strcmp(arg, "--file-api") == 0 || std::strcmp(arg, "-fa") == 0) {
+            fileApi = true;
+        } else if (std::strcmp(arg, "--sharded") == 0 || std::strcmp(arg, "-sd") == 0) {
+            sharded = true;
+        } else if (std::strcmp(arg, "--binary-index") == 0 || std::strcmp(arg, "-bi") == 0) {
+            binaryIndex = true;
+        } else if (std::strcmp(arg, "--progressive") == 0 || std::strcmp(arg, "-pg") == 0) {
+            progressiveOutput = true;
+        } else if (std::strcmp(arg, "--trace") == 0 || std::strcmp(arg, "-t") == 0) {
+            if (i == numArgs - 1_uz) {
+                compdbvs::logError("Expected value for trace\n");
+                return 1;
+            }
+
+#ifdef COMPDBVS_TRACING
+            tracePath = fs::absolute(argv[++i]);
+#else
+            compdbvs::logError("compdb-vs was built without COMPDBVS_TRACING, so --trace isn't available\n");
+            return 1;
+#endif
+        } else if (std::strcmp(arg, "--stats") == 0 || std::strcmp(arg, "-st") == 0) {
+            printStats = true;
         } else if (std::strcmp(arg, "--verbose") == 0 || std::strcmp(arg, "-v") == 0) {
             compdbvs::g_verbose = true;
         } else if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0) {
@@ -87,56 +209,191 @@ auto main(int argc, const char* argv[]) -> int
         }
     }
     
-    compdbvs::logInfo("Finding .tlog files\n");
+    if (tracePath) {
+        compdbvs::startTracing();
+    }
 
-    const auto fullBuildDir = fs::current_path() / buildDir;
+    std::vector<compdbvs::PhaseStats> phaseStats;
 
-    const auto tlogFiles = compdbvs::findTlogFiles(fullBuildDir, config);
-    if (!tlogFiles) {
-        compdbvs::logError("{}\n", tlogFiles.error().what());
+    if (fromVcxproj && fileApi) {
+        compdbvs::logError("--from-vcxproj and --file-api can't be used together\n");
         return 1;
     }
 
-    compdbvs::logInfo("Creating compile_commands.json\n");
+    options.configuration = config;
+
+    const auto fullBuildDir = fs::current_path() / buildDir;
+
+    if (fileApi) {
+        // the query only needs writing once, CMake answers it every time the project is configured after that
+        const compdbvs::PhaseMeter queryPhase{"Write File API query"};
+
+        const auto wroteQuery = compdbvs::writeFileApiQuery(fullBuildDir);
+        if (!wroteQuery) {
+            compdbvs::logError("{}\n", wroteQuery.error().what());
+            return 1;
+        }
+
+        if (*wroteQuery) {
+            compdbvs::logInfo("Asked CMake for its File API codemodel, it will be written the next time the project is configured\n");
+        }
+
+        phaseStats.push_back(queryPhase.finish());
+    }
+
+    // progressive mode makes the entries for the source files first and publishes them so clangd can get going,
+    // then finds the headers and publishes everything again
+    const auto progressive = progressiveOutput && !options.skipHeaders;
+    auto createOptions = options;
+    createOptions.skipHeaders = options.skipHeaders || progressive;
+
+    // the build directory is searched for tlogs (or .vcxproj files) while the ones already found are being read
+    if (fileApi) {
+        compdbvs::logInfo("Creating compile_commands.json\n");
+    } else if (fromVcxproj) {
+        compdbvs::logInfo("Creating compile_commands.json from .vcxproj files\n");
+    } else {
+        compdbvs::logInfo("Creating compile_commands.json from .tlog files\n");
+    }
+
+    const compdbvs::PhaseMeter createPhase{progressive ? "Create source compile commands" : "Create compile commands"};
 
-    const auto compileCommands = compdbvs::createCompileCommands(fullBuildDir, *tlogFiles, skipHeaders);
+    const auto buildInputs = fromVcxproj ? compdbvs::BuildInputs::Vcxproj : compdbvs::BuildInputs::Tlogs;
+    auto compileCommands = fileApi
+        ? compdbvs::createFileApiCompileCommands(fullBuildDir, config, createOptions)
+        : compdbvs::createBuildDirCompileCommands(fullBuildDir, buildInputs, createOptions);
     if (!compileCommands) {
         compdbvs::logError("{}\n", compileCommands.error().what());
         return 1;
     }
 
-    using namespace nlohmann;
-    auto outputJson = json::array();
+    phaseStats.push_back(createPhase.finish());
 
-    compdbvs::logInfo("Writing compile_commands.json\n");
+    const auto outputPath = fullBuildDir / "compile_commands.json";
+
+    // every file (the JSON, the index and each shard) is written to the side and renamed into place, so clangd never reads half of one.
+    // the entries are sorted first so a run over the same build writes the same bytes, and then the files are left alone.
+    // the store itself keeps the order they were made in, since --progressive goes on to search for headers from it
+    // and the owners picked there mustn't depend on whether the sources were written out first
+    auto writeOutput = [&] () -> bool {
+        const auto sortedCommands = compdbvs::sortCompileCommands(compileCommands->commands());
 
-    for (const auto& [directory, command, file] : *compileCommands) {
 #ifdef COMPDBVS_DEBUG
-        compdbvs::log("Command:\n");
-        compdbvs::log("directory: {}\n", directory);
-        compdbvs::log("command: {}\n", command);
-        compdbvs::log("file: {}\n", file);
-        compdbvs::log("\n");
+        for (const auto& [directory, command, file, owner, project] : sortedCommands) {
+            COMPDBVS_LOG("Command:\n");
+            COMPDBVS_LOG("directory: {}\n", directory);
+            COMPDBVS_LOG("command: {}\n", command);
+            COMPDBVS_LOG("file: {}\n", file);
+            COMPDBVS_LOG("owner: {}\n", owner);
+            COMPDBVS_LOG("project: {}\n", project);
+            COMPDBVS_LOG("\n");
+        }
 #endif
 
-        outputJson.push_back({
-            {"directory", directory},
-            {"command", command},
-            {"file", file},
-        });
+        if (sharded) {
+            COMPDBVS_TRACE_SCOPE("Write shards");
+            const auto shardDir = fullBuildDir / "compdb-vs-shards";
+            const auto summary = compdbvs::writeCompileCommandShards(shardDir, sortedCommands);
+            if (!summary) {
+                compdbvs::logError("{}\n", summary.error().what());
+                return false;
+            }
+
+            compdbvs::logInfo(
+                "{} of {} shards changed, {} removed\n",
+                summary->changedShardCount,
+                summary->shardCount,
+                summary->removedShardCount
+            );
+
+            const auto merged = compdbvs::writeFileAtomically(outputPath, [&shardDir] (std::ostream& outStream) {
+                return compdbvs::mergeCompileCommandShards(shardDir, outStream);
+            });
+            if (!merged) {
+                compdbvs::logError("{}\n", merged.error().what());
+                return false;
+            }
+        } else {
+            COMPDBVS_TRACE_SCOPE("Write JSON");
+            const auto written = compdbvs::writeFileAtomically(
+                outputPath,
+                [&sortedCommands] (std::ostream& outStream) -> compdbvs::Result<std::size_t, std::runtime_error> {
+                    compdbvs::writeCompileCommandsJson(outStream, sortedCommands);
+                    return sortedCommands.size();
+                }
+            );
+            if (!written) {
+                compdbvs::logError("{}\n", written.error().what());
+                return false;
+            }
+        }
+
+        if (binaryIndex) {
+            COMPDBVS_TRACE_SCOPE("Write binary index");
+            compdbvs::logInfo("Writing compile_commands.idx\n");
+
+            const auto indexed = compdbvs::writeFileAtomically(fullBuildDir / "compile_commands.idx", [&sortedCommands] (std::ostream& indexStream) {
+                return compdbvs::writeBinaryIndex(indexStream, sortedCommands);
+            }, std::ios::binary);
+            if (!indexed) {
+                compdbvs::logError("{}\n", indexed.error().what());
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    if (progressive) {
+        compdbvs::logInfo("Writing compile_commands.json for {} source files\n", compileCommands->size());
+        const compdbvs::PhaseMeter sourceWritePhase{"Write source output"};
+
+        if (!writeOutput()) {
+            return 1;
+        }
+
+        phaseStats.push_back(sourceWritePhase.finish());
+
+        compdbvs::logInfo("Sarching for header files\n");
+        const compdbvs::PhaseMeter headerPhase{"Create header compile commands"};
+
+        const auto headerCount = compdbvs::addHeaderCompileCommands(*compileCommands, options);
+        if (!headerCount) {
+            compdbvs::logError("{}\n", headerCount.error().what());
+            return 1;
+        }
+
+        phaseStats.push_back(headerPhase.finish());
     }
 
-    const auto outputPath = fullBuildDir / "compile_commands.json";
-    std::ofstream outStream{outputPath};
-    outStream << std::setw(4) << outputJson;
+    compdbvs::logInfo("Writing compile_commands.json\n");
+    const compdbvs::PhaseMeter writePhase{"Write output"};
 
-    if (!outStream) {
-        compdbvs::logError("Failed to write compile_commands.json\n");
+    if (!writeOutput()) {
         return 1;
     }
 
+    phaseStats.push_back(writePhase.finish());
+
+    if (tracePath) {
+        compdbvs::stopTracing();
+
+        std::ofstream traceStream{*tracePath};
+        compdbvs::writeTrace(traceStream);
+        if (!traceStream) {
+            compdbvs::logError("Failed to write trace to {}\n", tracePath->string());
+            return 1;
+        }
+    }
+
     const auto end = std::chrono::steady_clock::now();
     const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     compdbvs::logInfo("Finished in {} ms\n", duration);
+
+    if (printStats) {
+        for (const auto& stats : phaseStats) {
+            compdbvs::logInfo("{}\n", compdbvs::formatPhaseStats(stats));
+        }
+    }
 }
 
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "memory.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <fstream>
+#endif
+
+namespace compdbvs {
+namespace {
+// relaxed is fine, these are only read once the work being measured is done
+constinit std::atomic<bool> s_allocationCountingEnabled = false;
+constinit std::atomic<std::uint64_t> s_allocationCount = 0;
+constinit std::atomic<std::uint64_t> s_allocatedBytes = 0;
+constinit std::atomic<std::uint64_t> s_liveBytes = 0;
+constinit std::atomic<std::uint64_t> s_peakLiveBytes = 0;
+} // namespace
+
+[[nodiscard]] auto allocationCountingEnabled() noexcept -> bool
+{
+    return s_allocationCountingEnabled.load(std::memory_order_relaxed);
+}
+
+[[nodiscard]] auto allocationStats() noexcept -> AllocationStats
+{
+    return AllocationStats{
+        .allocationCount = s_allocationCount.load(std::memory_order_relaxed),
+        .allocatedBytes = s_allocatedBytes.load(std::memory_order_relaxed),
+        .liveBytes = s_liveBytes.load(std::memory_order_relaxed),
+        .peakLiveBytes = s_peakLiveBytes.load(std::memory_order_relaxed),
+    };
+}
+
+auto resetPeakLiveBytes() noexcept -> void
+{
+    s_peakLiveBytes.store(s_liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+[[nodiscard]] auto residentBytes() noexcept -> std::size_t
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.WorkingSetSize;
+    }
+
+    return 0;
+#else
+    // the second number is the resident pages, only Linux has this
+    std::ifstream statm{"/proc/self/statm"};
+    std::size_t totalPages = 0;
+    std::size_t residentPages = 0;
+    if (statm >> totalPages >> residentPages) {
+        return residentPages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    return 0;
+#endif
+}
+
+[[nodiscard]] auto peakResidentBytes() noexcept -> std::size_t
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+
+    return 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // kilobytes on Linux
+        return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+    }
+
+    return 0;
+#endif
+}
+
+PhaseMeter::PhaseMeter(std::string_view name)
+    : m_name{name}
+    , m_start{std::chrono::steady_clock::now()}
+{
+    // reading the resident size can allocate, so it's done before the allocations start counting towards the phase
+    m_startResidentBytes = residentBytes();
+    resetPeakLiveBytes();
+    m_startStats = allocationStats();
+}
+
+[[nodiscard]] auto PhaseMeter::finish() const -> PhaseStats
+{
+    const auto endStats = allocationStats();
+
+    return PhaseStats{
+        .name = m_name,
+        .duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start),
+        .allocationCount = endStats.allocationCount - m_startStats.allocationCount,
+        .allocatedBytes = endStats.allocatedBytes - m_startStats.allocatedBytes,
+        .peakLiveBytes = endStats.peakLiveBytes - std::min(endStats.peakLiveBytes, m_startStats.liveBytes),
+        .startResidentBytes = m_startResidentBytes,
+        .endResidentBytes = residentBytes(),
+        .processPeakResidentBytes = peakResidentBytes(),
+    };
+}
+
+[[nodiscard]] auto formatPhaseStats(const PhaseStats& stats) -> std::string
+{
+    const auto resident = fmt::format(
+        "RSS {} -> {}, process peak RSS {}",
+        detail::formatBytes(stats.startResidentBytes),
+        detail::formatBytes(stats.endResidentBytes),
+        detail::formatBytes(stats.processPeakResidentBytes)
+    );
+
+    if (!allocationCountingEnabled()) {
+        return fmt::format("{:<24} {:>6} ms, {}", stats.name, stats.duration.count(), resident);
+    }
+
+    return fmt::format(
+        "{:<24} {:>6} ms, {} allocations ({}), peak live {}, {}",
+        stats.name,
+        stats.duration.count(),
+        stats.allocationCount,
+        detail::formatBytes(stats.allocatedBytes),
+        detail::formatBytes(stats.peakLiveBytes),
+        resident
+    );
+}
+
+namespace detail {
+auto recordAllocation(std::size_t size) noexcept -> void
+{
+    s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    s_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+    const auto live = s_liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    auto peak = s_peakLiveBytes.load(std::memory_order_relaxed);
+    while (live > peak && !s_peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+
+    }
+}
+
+auto recordDeallocation(std::size_t size) noexcept -> void
+{
+    s_liveBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+auto setAllocationCountingEnabled() noexcept -> void
+{
+    s_allocationCountingEnabled.store(true, std::memory_order_relaxed);
+}
+
+[[nodiscard]] auto formatBytes(std::uint64_t bytes) -> std::string
+{
+    constexpr std::array units{"B", "KB", "MB", "GB"};
+
+    if (bytes < 1024) {
+        return fmt::format("{} B", bytes);
+    }
+
+    auto value = static_cast<double>(bytes);
+    auto unit = std::size_t{0};
+    while (value >= 1024.0 && unit + 1 < units.size()) {
+        value /= 1024.0;
+        unit++;
+    }
+
+    return fmt::format("{:.1f} {}", value, units[unit]);
+}
+} // namespace detail
+} // namespace compdbvs
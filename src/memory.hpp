@@ -0,0 +1,98 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_MEMORY_HPP
+#define COMPDBVS_MEMORY_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace compdbvs {
+// counted by the operator new/delete replacements in allocation-hooks.cpp, which are only linked into
+// the tests and into compdb-vs when it's built with COMPDBVS_ALLOCATION_COUNTING. without them these are all 0
+struct AllocationStats
+{
+    std::uint64_t allocationCount;
+    std::uint64_t allocatedBytes;
+    std::uint64_t liveBytes;
+    std::uint64_t peakLiveBytes;
+};
+
+[[nodiscard]] auto allocationCountingEnabled() noexcept -> bool;
+[[nodiscard]] auto allocationStats() noexcept -> AllocationStats;
+
+// so the peak of a phase can be measured rather than the peak of the whole run
+auto resetPeakLiveBytes() noexcept -> void;
+
+// the memory the process has resident right now, from the OS. 0 if it can't be found
+[[nodiscard]] auto residentBytes() noexcept -> std::size_t;
+
+// the most memory the process has had resident at once since it started, from the OS. 0 if it can't be found
+[[nodiscard]] auto peakResidentBytes() noexcept -> std::size_t;
+
+struct PhaseStats
+{
+    std::string name;
+    std::chrono::milliseconds duration;
+    std::uint64_t allocationCount;
+    std::uint64_t allocatedBytes;
+    // the most the phase had live at once, on top of what was already live when it started
+    std::uint64_t peakLiveBytes;
+    // what the process had resident when the phase started and finished
+    std::size_t startResidentBytes;
+    std::size_t endResidentBytes;
+    // the OS only keeps a peak for the whole process, so this includes every phase before this one
+    std::size_t processPeakResidentBytes;
+};
+
+// measures one phase of the run, from construction until finish()
+class PhaseMeter
+{
+public:
+    explicit PhaseMeter(std::string_view name);
+
+    [[nodiscard]] auto finish() const -> PhaseStats;
+
+private:
+    std::string m_name;
+    std::chrono::steady_clock::time_point m_start;
+    AllocationStats m_startStats;
+    std::size_t m_startResidentBytes;
+};
+
+// one line of --stats output
+[[nodiscard]] auto formatPhaseStats(const PhaseStats& stats) -> std::string;
+
+namespace detail {
+auto recordAllocation(std::size_t size) noexcept -> void;
+auto recordDeallocation(std::size_t size) noexcept -> void;
+auto setAllocationCountingEnabled() noexcept -> void;
+
+// 1536 gives "1.5 KB"
+[[nodiscard]] auto formatBytes(std::uint64_t bytes) -> std::string;
+} // namespace detail
+} // namespace compdbvs
+
+#endif // #ifndef COMPDBVS_MEMORY_HPP
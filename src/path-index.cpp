@@ -0,0 +1,81 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "path-index.hpp"
+
+#include <functional>
+
+namespace compdbvs::detail {
+ConcurrentPathIndex::ConcurrentPathIndex(std::size_t shardCount)
+    : m_shardCount{shardCount == 0 ? 1 : shardCount}
+    , m_shards{std::make_unique<Shard[]>(m_shardCount)}
+{
+}
+
+auto ConcurrentPathIndex::claim(const PathKey& key, std::uint64_t order) -> bool
+{
+    auto& shard = shardFor(key);
+    const std::lock_guard lock{shard.mutex};
+
+    const auto [it, inserted] = shard.owners.try_emplace(key, order);
+    if (inserted) {
+        return true;
+    }
+
+    if (order < it->second) {
+        it->second = order;
+        return true;
+    }
+
+    return order == it->second;
+}
+
+[[nodiscard]] auto ConcurrentPathIndex::owner(const PathKey& key) const -> std::optional<std::uint64_t>
+{
+    const auto& shard = shardFor(key);
+    const std::lock_guard lock{shard.mutex};
+
+    if (const auto it = shard.owners.find(key); it != shard.owners.end()) {
+        return it->second;
+    }
+
+    return std::nullopt;
+}
+
+[[nodiscard]] auto ConcurrentPathIndex::size() const -> std::size_t
+{
+    auto size = std::size_t{0};
+    for (auto i = std::size_t{0}; i < m_shardCount; i++) {
+        const std::lock_guard lock{m_shards[i].mutex};
+        size += m_shards[i].owners.size();
+    }
+
+    return size;
+}
+
+[[nodiscard]] auto ConcurrentPathIndex::shardFor(const PathKey& key) const -> Shard&
+{
+    // the maps hash the same way, so use the top bits here to keep a shard's keys spread over its buckets
+    const auto hash = std::hash<PathKey>{}(key);
+    return m_shards[(hash >> (sizeof(hash) * 4)) % m_shardCount];
+}
+} // namespace compdbvs::detail
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_PATH_INDEX_HPP
+#define COMPDBVS_PATH_INDEX_HPP
+
+#include "paths.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace compdbvs::detail {
+// which file belongs to whom, for workers that find files at the same time. each claim comes with an order
+// (the position of the project or TU that wants the file) and the lowest order wins whenever it arrives,
+// so the result is the same as claiming everything on one thread in order, however the threads interleave.
+// the paths are spread over shards that each have their own lock, so workers only wait for each other
+// when they happen to want files in the same shard at the same moment
+class ConcurrentPathIndex
+{
+public:
+    explicit ConcurrentPathIndex(std::size_t shardCount = 64);
+
+    // true if order is the earliest claim on key so far, which can still be beaten by an earlier one later
+    auto claim(const PathKey& key, std::uint64_t order) -> bool;
+
+    // the earliest claim on key, nullopt if it hasn't been claimed
+    [[nodiscard]] auto owner(const PathKey& key) const -> std::optional<std::uint64_t>;
+
+    // how many different paths have been claimed
+    [[nodiscard]] auto size() const -> std::size_t;
+
+private:
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<PathKey, std::uint64_t> owners;
+    };
+
+    [[nodiscard]] auto shardFor(const PathKey& key) const -> Shard&;
+
+    std::size_t m_shardCount;
+    std::unique_ptr<Shard[]> m_shards;
+};
+} // namespace compdbvs::detail
+
+#endif // #ifndef COMPDBVS_PATH_INDEX_HPP
@@ -0,0 +1,246 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "paths.hpp"
+#include "compdb-vs.hpp"
+
+#include <cctype>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COMPDBVS_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace compdbvs::detail {
+namespace {
+template<typename Char>
+[[nodiscard]] constexpr auto foldAscii(Char c) noexcept -> Char
+{
+    return c >= Char{'A'} && c <= Char{'Z'} ? static_cast<Char>(c + (Char{'a'} - Char{'A'})) : c;
+}
+
+#ifdef COMPDBVS_HAS_SSE2
+// adds 0x20 to the lanes holding 'A' to 'Z'. the compares are signed, so bytes (or wide units) with
+// the top bit set come out negative and are left alone, which is what foldAscii does too
+[[nodiscard]] inline auto foldAscii8(__m128i chars) noexcept -> __m128i
+{
+    const auto upper = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('Z' + 1)));
+    return _mm_add_epi8(chars, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+[[nodiscard]] inline auto foldAscii16(__m128i chars) noexcept -> __m128i
+{
+    const auto upper = _mm_and_si128(_mm_cmpgt_epi16(chars, _mm_set1_epi16('A' - 1)), _mm_cmplt_epi16(chars, _mm_set1_epi16('Z' + 1)));
+    return _mm_add_epi16(chars, _mm_and_si128(upper, _mm_set1_epi16(0x20)));
+}
+#endif
+
+template<typename Char>
+[[nodiscard]] auto equalsIgnoreCaseImpl(std::basic_string_view<Char> lhs, std::basic_string_view<Char> rhs) noexcept -> bool
+{
+    // most names in a directory differ in length from the one we want, so this is usually all that runs
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+
+    auto i = 0_uz;
+
+#ifdef COMPDBVS_HAS_SSE2
+    if constexpr (sizeof(Char) == 1_uz || sizeof(Char) == 2_uz) {
+        constexpr auto lanes = 16_uz / sizeof(Char);
+        for (; i + lanes <= lhs.size(); i += lanes) {
+            const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs.data() + i));
+            const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs.data() + i));
+            const auto equal = sizeof(Char) == 1_uz
+                ? _mm_cmpeq_epi8(foldAscii8(a), foldAscii8(b))
+                : _mm_cmpeq_epi16(foldAscii16(a), foldAscii16(b));
+            if (_mm_movemask_epi8(equal) != 0xFFFF) {
+                return false;
+            }
+        }
+    }
+#endif
+
+    for (; i < lhs.size(); i++) {
+        if (foldAscii(lhs[i]) != foldAscii(rhs[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<typename Char>
+[[nodiscard]] auto hashIgnoreCaseImpl(std::basic_string_view<Char> string) noexcept -> std::size_t
+{
+    // FNV-1a over whole code units, so wide and narrow strings of ASCII hash the same
+    auto hash = std::uint64_t{14695981039346656037ull};
+    for (const auto c : string) {
+        hash ^= static_cast<std::make_unsigned_t<Char>>(foldAscii(c));
+        hash *= 1099511628211ull;
+    }
+
+    return static_cast<std::size_t>(hash);
+}
+} // namespace
+
+[[nodiscard]] auto foldPath(std::string_view path) -> std::string
+{
+    std::string folded;
+    folded.reserve(path.size());
+
+    for (const auto c : path) {
+        if (c == '\\' || c == '/') {
+            // collapse repeated separators so "C:\\foo\\\\bar" and "C:/foo/bar" compare equal
+            if (!folded.empty() && folded.back() == '/') {
+                continue;
+            }
+            folded.push_back('/');
+        } else {
+            folded.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+        }
+    }
+
+    if (folded.size() > 1_uz && folded.back() == '/') {
+        folded.pop_back();
+    }
+
+    return folded;
+}
+
+[[nodiscard]] auto equalsIgnoreCase(std::string_view lhs, std::string_view rhs) noexcept -> bool
+{
+    return equalsIgnoreCaseImpl(lhs, rhs);
+}
+
+[[nodiscard]] auto equalsIgnoreCase(std::wstring_view lhs, std::wstring_view rhs) noexcept -> bool
+{
+    return equalsIgnoreCaseImpl(lhs, rhs);
+}
+
+[[nodiscard]] auto hashIgnoreCase(std::string_view string) noexcept -> std::size_t
+{
+    return hashIgnoreCaseImpl(string);
+}
+
+[[nodiscard]] auto hashIgnoreCase(std::wstring_view string) noexcept -> std::size_t
+{
+    return hashIgnoreCaseImpl(string);
+}
+
+[[nodiscard]] auto filenameView(const fs::path& path) noexcept -> std::basic_string_view<fs::path::value_type>
+{
+    const std::basic_string_view<fs::path::value_type> native = path.native();
+    constexpr fs::path::value_type separators[] = {'/', fs::path::preferred_separator, '\0'};
+    const auto separator = native.find_last_of(separators);
+    return separator == native.npos ? native : native.substr(separator + 1_uz);
+}
+
+[[nodiscard]] auto isAbsoluteWindowsPath(std::string_view path) -> bool
+{
+    if (path.starts_with('/') || path.starts_with('\\')) {
+        return true;
+    }
+
+    return path.size() > 2 && std::isalpha(static_cast<unsigned char>(path[0])) && path[1] == ':' && (path[2] == '/' || path[2] == '\\');
+}
+
+[[nodiscard]] auto isPathWithin(const fs::path& path, const fs::path& directory) -> bool
+{
+    const auto foldedPath = foldPath(path.lexically_normal().string());
+    const auto foldedDirectory = foldPath(directory.lexically_normal().string());
+
+    if (foldedDirectory.empty() || !foldedPath.starts_with(foldedDirectory)) {
+        return false;
+    }
+
+    return foldedPath.size() == foldedDirectory.size()
+        || foldedDirectory.back() == '/'
+        || foldedPath[foldedDirectory.size()] == '/';
+}
+
+[[nodiscard]] auto matchesGlob(std::string_view path, std::string_view glob) -> bool
+{
+    const auto foldedPath = foldPath(path);
+    const auto foldedGlob = foldPath(glob);
+
+    // iterative wildcard matching with backtracking to the last '*' (and separately the last "**",
+    // which is allowed to swallow separators), so this doesn't go exponential on patterns like "**/*/**"
+    auto p = 0_uz;
+    auto g = 0_uz;
+    auto starGlob = std::string::npos;
+    auto starPath = 0_uz;
+    auto globstarGlob = std::string::npos;
+    auto globstarPath = 0_uz;
+
+    while (p < foldedPath.size()) {
+        if (g < foldedGlob.size()) {
+            if (foldedGlob.compare(g, 2_uz, "**") == 0) {
+                globstarGlob = g + 2_uz;
+                // "**/" also matches no directories at all
+                if (globstarGlob < foldedGlob.size() && foldedGlob[globstarGlob] == '/') {
+                    globstarGlob++;
+                }
+                globstarPath = p;
+                starGlob = std::string::npos;
+                g = globstarGlob;
+                continue;
+            }
+
+            if (foldedGlob[g] == '*') {
+                starGlob = ++g;
+                starPath = p;
+                continue;
+            }
+
+            if ((foldedGlob[g] == '?' && foldedPath[p] != '/') || foldedGlob[g] == foldedPath[p]) {
+                g++;
+                p++;
+                continue;
+            }
+        }
+
+        if (starGlob != std::string::npos && foldedPath[starPath] != '/') {
+            g = starGlob;
+            p = ++starPath;
+            continue;
+        }
+
+        if (globstarGlob != std::string::npos) {
+            g = globstarGlob;
+            p = ++globstarPath;
+            starGlob = std::string::npos;
+            continue;
+        }
+
+        return false;
+    }
+
+    while (g < foldedGlob.size() && foldedGlob[g] == '*') {
+        g++;
+    }
+
+    return g == foldedGlob.size();
+}
+} // namespace compdbvs::detail
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_PATHS_HPP
+#define COMPDBVS_PATHS_HPP
+
+#include <compare>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace compdbvs::detail {
+// Windows paths are case insensitive and can use either separator,
+// so comparisons go through a lower-cased, forward-slashed copy without any trailing slash
+[[nodiscard]] auto foldPath(std::string_view path) -> std::string;
+
+// ASCII case insensitive equality without making lower-cased copies, long strings are folded 16 bytes at a time.
+// there's a wide overload because that's what fs::path holds on Windows
+[[nodiscard]] auto equalsIgnoreCase(std::string_view lhs, std::string_view rhs) noexcept -> bool;
+[[nodiscard]] auto equalsIgnoreCase(std::wstring_view lhs, std::wstring_view rhs) noexcept -> bool;
+
+// a hash that's the same for two strings whenever equalsIgnoreCase says they're equal, again without a lower-cased copy
+[[nodiscard]] auto hashIgnoreCase(std::string_view string) noexcept -> std::size_t;
+[[nodiscard]] auto hashIgnoreCase(std::wstring_view string) noexcept -> std::size_t;
+
+// the last component of path as a view into its native string, the same thing path.filename() gives
+// for the paths we deal with but without allocating a new path
+[[nodiscard]] auto filenameView(const std::filesystem::path& path) noexcept -> std::basic_string_view<std::filesystem::path::value_type>;
+
+// a path as Windows compares them, for keying sets and maps. the folded form is made once when the key is,
+// so hashing and comparing are plain string operations, and two spellings of the same file (C:\FOO\BAR.CPP and
+// c:/foo/bar.cpp) are the same key without either needing its casing fixed on disk first
+class PathKey
+{
+public:
+    PathKey() = default;
+
+    explicit PathKey(std::string_view path)
+        : m_folded{foldPath(path)}
+    {
+    }
+
+    [[nodiscard]] auto folded() const noexcept -> std::string_view
+    {
+        return m_folded;
+    }
+
+    [[nodiscard]] auto operator==(const PathKey& other) const noexcept -> bool = default;
+    [[nodiscard]] auto operator<=>(const PathKey& other) const noexcept = default;
+
+private:
+    std::string m_folded;
+};
+
+// true if path is directory or anything inside it, ignoring case and separators
+[[nodiscard]] auto isPathWithin(const std::filesystem::path& path, const std::filesystem::path& directory) -> bool;
+
+// whether path starts from a drive or the root, checked on the string so that a Windows path like C:/foo
+// counts on any platform, std::filesystem only thinks it's absolute when running on Windows
+[[nodiscard]] auto isAbsoluteWindowsPath(std::string_view path) -> bool;
+
+// matches a path against a glob, ignoring case and separators.
+// '*' and '?' don't cross a separator, "**" matches any number of directories
+[[nodiscard]] auto matchesGlob(std::string_view path, std::string_view glob) -> bool;
+} // namespace compdbvs::detail
+
+template<>
+struct std::hash<compdbvs::detail::PathKey>
+{
+    [[nodiscard]] auto operator()(const compdbvs::detail::PathKey& key) const noexcept -> std::size_t
+    {
+        return std::hash<std::string_view>{}(key.folded());
+    }
+};
+
+#endif // #ifndef COMPDBVS_PATHS_HPP
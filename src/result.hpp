@@ -25,13 +25,166 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <exception>
+#include <filesystem>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <type_traits>
 #include <variant>
 
 namespace compdbvs {
+enum class ErrorCode
+{
+    NotFound,
+    NotADirectory,
+    NoMatchingEntry,
+    Filesystem,
+};
+
+// an error for the paths that fail all the time, like probing for a header on every include path.
+// the context (normally a path) is copied into an inline buffer and the message isn't formatted
+// until someone calls what(), so making one of these and throwing it away never touches the heap.
+// what() caches the message in the error it's called on, so an Error shouldn't be shared between threads
+// that might both call what() - hand each thread its own copy instead, copies format their own message
+class Error : public std::exception
+{
+public:
+    using Char = std::filesystem::path::value_type;
+
+    Error(ErrorCode code, const std::filesystem::path& context) noexcept
+        : m_code{code}
+    {
+        setContext(std::basic_string_view<Char>{context.native()});
+    }
+
+    // for errors that came from the OS, the system message is only looked up when what() is called
+    Error(ErrorCode code, const std::filesystem::path& context, std::error_code systemError) noexcept
+        : m_code{code}
+        , m_systemError{systemError}
+    {
+        setContext(std::basic_string_view<Char>{context.native()});
+    }
+
+    Error(ErrorCode code, std::string_view context) noexcept
+        : m_code{code}
+    {
+        // only used for our own ASCII messages, so widening char by char is fine on Windows
+        setContext(context);
+    }
+
+    // a copy doesn't take the cached message, so it's safe to give to another thread even after what() was called
+    Error(const Error& other) noexcept
+        : std::exception{other}
+        , m_code{other.m_code}
+        , m_systemError{other.m_systemError}
+        , m_context{other.m_context}
+        , m_contextSize{other.m_contextSize}
+    {
+
+    }
+
+    Error(Error&&) noexcept = default;
+
+    Error& operator=(const Error& other) noexcept
+    {
+        if (this != &other) {
+            std::exception::operator=(other);
+            m_code = other.m_code;
+            m_systemError = other.m_systemError;
+            m_context = other.m_context;
+            m_contextSize = other.m_contextSize;
+            m_message.clear();
+        }
+
+        return *this;
+    }
+
+    Error& operator=(Error&&) noexcept = default;
+
+    ~Error() override = default;
+
+    [[nodiscard]] auto code() const noexcept -> ErrorCode
+    {
+        return m_code;
+    }
+
+    [[nodiscard]] auto context() const -> std::filesystem::path
+    {
+        return std::filesystem::path{std::basic_string_view<Char>{m_context.data(), m_contextSize}};
+    }
+
+    [[nodiscard]] auto systemError() const noexcept -> std::error_code
+    {
+        return m_systemError;
+    }
+
+    [[nodiscard]] const char* what() const noexcept override
+    {
+        if (m_message.empty()) {
+            try {
+                m_message = formatMessage();
+            } catch (...) {
+                return "compdb-vs error (failed to format the message)";
+            }
+        }
+
+        return m_message.c_str();
+    }
+
+    // for passing the error on through functions that return Result<T, std::runtime_error>
+    [[nodiscard]] auto toRuntimeError() const -> std::runtime_error
+    {
+        return std::runtime_error{what()};
+    }
+
+private:
+    // MAX_PATH, anything longer keeps the end since the file name is the interesting part
+    static constexpr std::size_t s_maxContextSize = 260;
+
+    template<typename TChar>
+    auto setContext(std::basic_string_view<TChar> context) noexcept -> void
+    {
+        if (context.size() > s_maxContextSize) {
+            context = context.substr(context.size() - s_maxContextSize);
+        }
+
+        std::ranges::copy(context, m_context.begin());
+        m_contextSize = context.size();
+    }
+
+    [[nodiscard]] auto formatMessage() const -> std::string
+    {
+        const auto context = this->context().string();
+        switch (m_code) {
+            case ErrorCode::NotFound:
+                return fmt::format("{} did not exist", context);
+            case ErrorCode::NotADirectory:
+                return fmt::format("Directory {} did not exist", context);
+            case ErrorCode::NoMatchingEntry:
+                return fmt::format("Didn't find entry in parent that matched {}", context);
+            case ErrorCode::Filesystem:
+                if (m_systemError) {
+                    return fmt::format("Filesystem error on {}: {}", context, m_systemError.message());
+                }
+
+                return fmt::format("Filesystem error: {}", context);
+        }
+
+        return context;
+    }
+
+    ErrorCode m_code;
+    std::error_code m_systemError;
+    std::array<Char, s_maxContextSize> m_context;
+    std::size_t m_contextSize = 0;
+    mutable std::string m_message;
+};
+
 template<typename TResult, typename TException> requires(std::is_base_of_v<std::exception, TException>)
 class [[nodiscard]] Result
 {
@@ -52,7 +205,7 @@ public:
 
         ~BadResultAccess() override = default;
 
-        [[nodiscard]] const char* what() const override
+        [[nodiscard]] const char* what() const noexcept override
         {
             return m_message.c_str();
         }
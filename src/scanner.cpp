@@ -0,0 +1,809 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "scanner.hpp"
+#include "compdb-vs.hpp"
+#include "flags.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <limits>
+
+namespace compdbvs::detail {
+namespace {
+// clangd parses the commands as clang-cl, which never defines these,
+// so anything behind them is dead no matter what headers were included before
+constexpr std::array s_undefinedPlatformMacros = {
+    "__APPLE__", "__MACH__", "__linux__", "__linux", "linux", "__unix__", "__unix", "unix",
+    "__ANDROID__", "__FreeBSD__", "__NetBSD__", "__OpenBSD__", "__EMSCRIPTEN__", "__HAIKU__",
+    "__CYGWIN__", "__MINGW32__", "__MINGW64__", "__GNUC__",
+};
+
+[[nodiscard]] auto isIdentifierChar(char c) -> bool
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+[[nodiscard]] auto trimStart(std::string_view string) -> std::string_view
+{
+    while (!string.empty() && std::isspace(static_cast<unsigned char>(string.front()))) {
+        string.remove_prefix(1_uz);
+    }
+    return string;
+}
+
+[[nodiscard]] auto trim(std::string_view string) -> std::string_view
+{
+    string = trimStart(string);
+    while (!string.empty() && std::isspace(static_cast<unsigned char>(string.back()))) {
+        string.remove_suffix(1_uz);
+    }
+    return string;
+}
+
+[[nodiscard]] auto takeIdentifier(std::string_view& string) -> std::string_view
+{
+    string = trimStart(string);
+    auto end = 0_uz;
+    while (end < string.size() && isIdentifierChar(string[end])) {
+        end++;
+    }
+
+    const auto identifier = string.substr(0_uz, end);
+    string.remove_prefix(end);
+    return identifier;
+}
+
+[[nodiscard]] auto isDefined(std::string_view name, const MacroDefinitions& macros) -> Condition
+{
+    const auto it = macros.find(std::string{name});
+    if (it == macros.end()) {
+        return Condition::Unknown;
+    }
+
+    return it->second ? Condition::True : Condition::False;
+}
+
+[[nodiscard]] auto invert(Condition condition) -> Condition
+{
+    switch (condition) {
+        case Condition::True:
+            return Condition::False;
+        case Condition::False:
+            return Condition::True;
+        default:
+            return Condition::Unknown;
+    }
+}
+
+// recursive descent over the #if expression grammar, with nullopt standing in for "can't tell"
+class ConditionParser
+{
+public:
+    using Value = std::optional<long long>;
+
+    ConditionParser(std::string_view expression, const MacroDefinitions& macros, std::size_t depth)
+        : m_expression{expression}
+        , m_macros{macros}
+        , m_depth{depth}
+    {
+
+    }
+
+    [[nodiscard]] auto parse() -> Value
+    {
+        const auto value = parseTernary();
+        skipWhitespace();
+        if (m_failed || m_pos != m_expression.size()) {
+            return std::nullopt;
+        }
+
+        return value;
+    }
+
+private:
+    static constexpr auto s_maxMacroDepth = 8_uz;
+
+    auto skipWhitespace() -> void
+    {
+        while (m_pos < m_expression.size() && std::isspace(static_cast<unsigned char>(m_expression[m_pos]))) {
+            m_pos++;
+        }
+    }
+
+    [[nodiscard]] auto consume(std::string_view op) -> bool
+    {
+        skipWhitespace();
+        if (!m_expression.substr(m_pos).starts_with(op)) {
+            return false;
+        }
+
+        // don't let '<' match the start of "<=" or "<<", '!' match "!=" etc
+        if (op.size() == 1_uz && m_pos + 1_uz < m_expression.size()) {
+            const auto next = m_expression[m_pos + 1_uz];
+            if ((op == "&" || op == "|" || op == "<" || op == ">") && next == op[0]) {
+                return false;
+            }
+
+            if ((op == "<" || op == ">" || op == "!" || op == "=") && next == '=') {
+                return false;
+            }
+        }
+
+        m_pos += op.size();
+        return true;
+    }
+
+    template<typename TOperation>
+    [[nodiscard]] static auto combine(Value lhs, Value rhs, TOperation operation) -> Value
+    {
+        if (!lhs || !rhs) {
+            return std::nullopt;
+        }
+
+        return operation(*lhs, *rhs);
+    }
+
+    // wrapping arithmetic, overflow in an #if isn't worth being undefined behaviour over
+    [[nodiscard]] static auto wrap(unsigned long long value) -> long long
+    {
+        return static_cast<long long>(value);
+    }
+
+    [[nodiscard]] auto parseTernary() -> Value
+    {
+        const auto condition = parseLogicalOr();
+        if (!consume("?")) {
+            return condition;
+        }
+
+        const auto whenTrue = parseTernary();
+        if (!consume(":")) {
+            m_failed = true;
+            return std::nullopt;
+        }
+
+        const auto whenFalse = parseTernary();
+        if (!condition) {
+            return whenTrue == whenFalse ? whenTrue : std::nullopt;
+        }
+
+        return *condition != 0 ? whenTrue : whenFalse;
+    }
+
+    [[nodiscard]] auto parseLogicalOr() -> Value
+    {
+        auto lhs = parseLogicalAnd();
+        while (consume("||")) {
+            const auto rhs = parseLogicalAnd();
+            if ((lhs && *lhs != 0) || (rhs && *rhs != 0)) {
+                lhs = 1;
+            } else if (lhs && rhs) {
+                lhs = 0;
+            } else {
+                lhs = std::nullopt;
+            }
+        }
+        return lhs;
+    }
+
+    [[nodiscard]] auto parseLogicalAnd() -> Value
+    {
+        auto lhs = parseBitOr();
+        while (consume("&&")) {
+            const auto rhs = parseBitOr();
+            if ((lhs && *lhs == 0) || (rhs && *rhs == 0)) {
+                lhs = 0;
+            } else if (lhs && rhs) {
+                lhs = 1;
+            } else {
+                lhs = std::nullopt;
+            }
+        }
+        return lhs;
+    }
+
+    [[nodiscard]] auto parseBitOr() -> Value
+    {
+        auto lhs = parseBitXor();
+        while (consume("|")) {
+            lhs = combine(lhs, parseBitXor(), [] (long long l, long long r) -> Value { return l | r; });
+        }
+        return lhs;
+    }
+
+    [[nodiscard]] auto parseBitXor() -> Value
+    {
+        auto lhs = parseBitAnd();
+        while (consume("^")) {
+            lhs = combine(lhs, parseBitAnd(), [] (long long l, long long r) -> Value { return l ^ r; });
+        }
+        return lhs;
+    }
+
+    [[nodiscard]] auto parseBitAnd() -> Value
+    {
+        auto lhs = parseEquality();
+        while (consume("&")) {
+            lhs = combine(lhs, parseEquality(), [] (long long l, long long r) -> Value { return l & r; });
+        }
+        return lhs;
+    }
+
+    [[nodiscard]] auto parseEquality() -> Value
+    {
+        auto lhs = parseRelational();
+        while (true) {
+            if (consume("==")) {
+                lhs = combine(lhs, parseRelational(), [] (long long l, long long r) -> Value { return l == r; });
+            } else if (consume("!=")) {
+                lhs = combine(lhs, parseRelational(), [] (long long l, long long r) -> Value { return l != r; });
+            } else {
+                return lhs;
+            }
+        }
+    }
+
+    [[nodiscard]] auto parseRelational() -> Value
+    {
+        auto lhs = parseShift();
+        while (true) {
+            if (consume("<=")) {
+                lhs = combine(lhs, parseShift(), [] (long long l, long long r) -> Value { return l <= r; });
+            } else if (consume(">=")) {
+                lhs = combine(lhs, parseShift(), [] (long long l, long long r) -> Value { return l >= r; });
+            } else if (consume("<")) {
+                lhs = combine(lhs, parseShift(), [] (long long l, long long r) -> Value { return l < r; });
+            } else if (consume(">")) {
+                lhs = combine(lhs, parseShift(), [] (long long l, long long r) -> Value { return l > r; });
+            } else {
+                return lhs;
+            }
+        }
+    }
+
+    [[nodiscard]] auto parseShift() -> Value
+    {
+        auto lhs = parseAdditive();
+        while (true) {
+            const auto left = consume("<<");
+            if (!left && !consume(">>")) {
+                return lhs;
+            }
+
+            lhs = combine(lhs, parseAdditive(), [left] (long long l, long long r) -> Value {
+                if (r < 0 || r >= 63) {
+                    return std::nullopt;
+                }
+                return left ? wrap(static_cast<unsigned long long>(l) << r) : l >> r;
+            });
+        }
+    }
+
+    [[nodiscard]] auto parseAdditive() -> Value
+    {
+        auto lhs = parseMultiplicative();
+        while (true) {
+            if (consume("+")) {
+                lhs = combine(lhs, parseMultiplicative(), [] (long long l, long long r) -> Value {
+                    return wrap(static_cast<unsigned long long>(l) + static_cast<unsigned long long>(r));
+                });
+            } else if (consume("-")) {
+                lhs = combine(lhs, parseMultiplicative(), [] (long long l, long long r) -> Value {
+                    return wrap(static_cast<unsigned long long>(l) - static_cast<unsigned long long>(r));
+                });
+            } else {
+                return lhs;
+            }
+        }
+    }
+
+    [[nodiscard]] auto parseMultiplicative() -> Value
+    {
+        auto lhs = parseUnary();
+        while (true) {
+            if (consume("*")) {
+                lhs = combine(lhs, parseUnary(), [] (long long l, long long r) -> Value {
+                    return wrap(static_cast<unsigned long long>(l) * static_cast<unsigned long long>(r));
+                });
+            } else if (consume("/")) {
+                lhs = combine(lhs, parseUnary(), [] (long long l, long long r) -> Value {
+                    return r == 0 || (l == std::numeric_limits<long long>::min() && r == -1) ? std::nullopt : Value{l / r};
+                });
+            } else if (consume("%")) {
+                lhs = combine(lhs, parseUnary(), [] (long long l, long long r) -> Value {
+                    return r == 0 || (l == std::numeric_limits<long long>::min() && r == -1) ? std::nullopt : Value{l % r};
+                });
+            } else {
+                return lhs;
+            }
+        }
+    }
+
+    [[nodiscard]] auto parseUnary() -> Value
+    {
+        if (consume("!")) {
+            const auto value = parseUnary();
+            return value ? Value{*value == 0} : std::nullopt;
+        }
+
+        if (consume("~")) {
+            const auto value = parseUnary();
+            return value ? Value{~*value} : std::nullopt;
+        }
+
+        if (consume("-")) {
+            const auto value = parseUnary();
+            return value ? Value{wrap(0ull - static_cast<unsigned long long>(*value))} : std::nullopt;
+        }
+
+        if (consume("+")) {
+            return parseUnary();
+        }
+
+        return parsePrimary();
+    }
+
+    // skips a balanced (...) group, used for things we can't evaluate like function-like macros and __has_include
+    auto skipParentheses() -> void
+    {
+        auto depth = 0_uz;
+        while (m_pos < m_expression.size()) {
+            const auto c = m_expression[m_pos++];
+            if (c == '(') {
+                depth++;
+            } else if (c == ')' && --depth == 0_uz) {
+                return;
+            }
+        }
+
+        m_failed = true;
+    }
+
+    [[nodiscard]] auto parsePrimary() -> Value
+    {
+        skipWhitespace();
+        if (m_pos == m_expression.size()) {
+            m_failed = true;
+            return std::nullopt;
+        }
+
+        if (consume("(")) {
+            const auto value = parseTernary();
+            if (!consume(")")) {
+                m_failed = true;
+            }
+            return value;
+        }
+
+        const auto c = m_expression[m_pos];
+
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            return parseNumber();
+        }
+
+        if (c == '\'') {
+            // character literals are rare enough in #if to not bother with
+            const auto end = m_expression.find('\'', m_pos + 1_uz);
+            if (end == std::string_view::npos) {
+                m_failed = true;
+            } else {
+                m_pos = end + 1_uz;
+            }
+            return std::nullopt;
+        }
+
+        if (!isIdentifierChar(c)) {
+            m_failed = true;
+            return std::nullopt;
+        }
+
+        auto rest = m_expression.substr(m_pos);
+        const auto identifier = takeIdentifier(rest);
+        m_pos = m_expression.size() - rest.size();
+
+        if (identifier == "defined") {
+            const auto parenthesised = consume("(");
+            rest = m_expression.substr(m_pos);
+            const auto name = takeIdentifier(rest);
+            m_pos = m_expression.size() - rest.size();
+
+            if (name.empty() || (parenthesised && !consume(")"))) {
+                m_failed = true;
+                return std::nullopt;
+            }
+
+            switch (isDefined(name, m_macros)) {
+                case Condition::True:
+                    return 1;
+                case Condition::False:
+                    return 0;
+                default:
+                    return std::nullopt;
+            }
+        }
+
+        if (identifier == "true") {
+            return 1;
+        }
+
+        if (identifier == "false") {
+            return 0;
+        }
+
+        skipWhitespace();
+        if (m_pos < m_expression.size() && m_expression[m_pos] == '(') {
+            skipParentheses();
+            return std::nullopt;
+        }
+
+        const auto it = m_macros.find(std::string{identifier});
+        if (it == m_macros.end()) {
+            return std::nullopt;
+        }
+
+        if (!it->second) {
+            // undefined identifiers are 0 in #if
+            return 0;
+        }
+
+        if (m_depth >= s_maxMacroDepth) {
+            return std::nullopt;
+        }
+
+        return ConditionParser{*it->second, m_macros, m_depth + 1_uz}.parse();
+    }
+
+    [[nodiscard]] auto parseNumber() -> Value
+    {
+        auto end = m_pos;
+        while (end < m_expression.size() && (isIdentifierChar(m_expression[end]) || m_expression[end] == '\'')) {
+            end++;
+        }
+
+        std::string digits;
+        for (const auto c : m_expression.substr(m_pos, end - m_pos)) {
+            if (c != '\'') {
+                digits.push_back(c);
+            }
+        }
+
+        m_pos = end;
+
+        while (!digits.empty() && (digits.back() == 'u' || digits.back() == 'U' || digits.back() == 'l' || digits.back() == 'L')) {
+            digits.pop_back();
+        }
+
+        auto base = 10;
+        std::string_view number = digits;
+        if (number.starts_with("0x") || number.starts_with("0X")) {
+            base = 16;
+            number.remove_prefix(2_uz);
+        } else if (number.starts_with("0b") || number.starts_with("0B")) {
+            base = 2;
+            number.remove_prefix(2_uz);
+        } else if (number.size() > 1_uz && number.starts_with('0')) {
+            base = 8;
+            number.remove_prefix(1_uz);
+        }
+
+        unsigned long long value = 0;
+        const auto [ptr, ec] = std::from_chars(number.data(), number.data() + number.size(), value, base);
+        if (ec != std::errc{} || ptr != number.data() + number.size()) {
+            m_failed = true;
+            return std::nullopt;
+        }
+
+        return wrap(value);
+    }
+
+    std::string_view m_expression;
+    const MacroDefinitions& m_macros;
+    std::size_t m_depth;
+    std::size_t m_pos = 0_uz;
+    bool m_failed = false;
+};
+
+// replaces comments with a space, carrying the state of a /* */ across lines
+[[nodiscard]] auto stripComments(std::string_view line, bool& inBlockComment) -> std::string
+{
+    std::string result;
+    result.reserve(line.size());
+
+    for (auto i = 0_uz; i < line.size(); i++) {
+        if (inBlockComment) {
+            if (line[i] == '*' && i + 1_uz < line.size() && line[i + 1_uz] == '/') {
+                inBlockComment = false;
+                result.push_back(' ');
+                i++;
+            }
+            continue;
+        }
+
+        const auto c = line[i];
+        if (c == '/' && i + 1_uz < line.size() && line[i + 1_uz] == '*') {
+            inBlockComment = true;
+            i++;
+        } else if (c == '/' && i + 1_uz < line.size() && line[i + 1_uz] == '/') {
+            break;
+        } else if (c == '"' || (c == '\'' && (i == 0_uz || !isIdentifierChar(line[i - 1_uz])))) {
+            // copy literals as is so a "/*" in a string doesn't start a comment,
+            // the identifier check stops digit separators (1'000) being taken for char literals
+            result.push_back(c);
+            for (i++; i < line.size(); i++) {
+                result.push_back(line[i]);
+                if (line[i] == c) {
+                    break;
+                }
+
+                if (line[i] == '\\' && c == '\'' && i + 1_uz < line.size()) {
+                    result.push_back(line[++i]);
+                }
+            }
+        } else {
+            result.push_back(c);
+        }
+    }
+
+    return result;
+}
+
+struct ConditionalBlock
+{
+    // whether the #if this belongs to was in live code
+    bool parentLive;
+    // whether an earlier branch was definitely taken, so the rest are dead
+    bool taken;
+    // whether an earlier branch's condition couldn't be worked out, so it might have been taken
+    bool maybeTaken;
+    bool live;
+    // whether this branch is definitely the one that's compiled, rather than just might be
+    bool certain;
+};
+} // namespace
+
+[[nodiscard]] auto findDefines(std::string_view command) -> MacroDefinitions
+{
+    MacroDefinitions macros;
+    for (const auto name : s_undefinedPlatformMacros) {
+        macros.emplace(name, std::nullopt);
+    }
+
+    macros.emplace("_WIN32", "1");
+    // defined, but the version clangd will claim is anyone's guess
+    macros.emplace("_MSC_VER", "");
+
+    auto unquote = [] (std::string_view value) -> std::string {
+        std::string result;
+        for (auto i = 0_uz; i < value.size(); i++) {
+            if (value[i] == '\\' && i + 1_uz < value.size() && value[i + 1_uz] == '"') {
+                result.push_back('"');
+                i++;
+            } else if (value[i] != '"') {
+                result.push_back(value[i]);
+            }
+        }
+        return result;
+    };
+
+    auto pos = 0_uz;
+    while (true) {
+        const auto token = nextCommandToken(command, pos);
+        if (token.empty()) {
+            break;
+        }
+
+        const auto flag = findFlag(token);
+        if (flag == nullptr || (flag->name != "/D" && flag->name != "/U")) {
+            continue;
+        }
+
+        auto value = token.substr(flag->name.size());
+        if (value.empty()) {
+            value = nextCommandToken(command, pos);
+        }
+
+        const auto definition = unquote(value);
+
+        if (flag->name == "/U") {
+            macros[definition] = std::nullopt;
+            continue;
+        }
+
+        // cl.exe accepts both /DFOO=1 and /DFOO#1
+        const auto equals = definition.find_first_of("=#");
+        if (equals == std::string::npos) {
+            macros[definition] = "1";
+        } else {
+            macros[definition.substr(0_uz, equals)] = definition.substr(equals + 1_uz);
+        }
+    }
+
+    return macros;
+}
+
+[[nodiscard]] auto evaluateCondition(std::string_view expression, const MacroDefinitions& macros) -> Condition
+{
+    const auto value = ConditionParser{expression, macros, 0_uz}.parse();
+    if (!value) {
+        return Condition::Unknown;
+    }
+
+    return *value != 0 ? Condition::True : Condition::False;
+}
+
+[[nodiscard]] auto findIncludedFiles(
+    std::span<const std::string> lines,
+    const MacroDefinitions& defines,
+    bool isObjC
+) -> std::vector<IncludedFile>
+{
+    std::vector<IncludedFile> includedFiles;
+
+    // the file's own #defines and #undefs only apply to the rest of this file
+    auto macros = defines;
+    std::vector<ConditionalBlock> conditionals;
+    auto inBlockComment = false;
+    std::string logicalLine;
+
+    auto isLive = [&conditionals] {
+        return conditionals.empty() || conditionals.back().live;
+    };
+
+    auto isCertain = [&conditionals] {
+        return std::ranges::all_of(conditionals, &ConditionalBlock::certain);
+    };
+
+    for (const auto& line : lines) {
+        logicalLine.append(line);
+        if (!logicalLine.empty() && logicalLine.back() == '\\') {
+            logicalLine.pop_back();
+            continue;
+        }
+
+        const auto code = stripComments(logicalLine, inBlockComment);
+        logicalLine.clear();
+
+        auto l = trimStart(code);
+        if (!l.starts_with('#')) {
+            continue;
+        }
+
+        l.remove_prefix(1_uz);
+        const auto directive = takeIdentifier(l);
+        const auto rest = trim(l);
+
+        if (directive == "if" || directive == "ifdef" || directive == "ifndef") {
+            const auto parentLive = isLive();
+            auto condition = Condition::False;
+            if (parentLive) {
+                if (directive == "if") {
+                    condition = evaluateCondition(rest, macros);
+                } else {
+                    auto r = rest;
+                    condition = isDefined(takeIdentifier(r), macros);
+                    if (directive == "ifndef") {
+                        condition = invert(condition);
+                    }
+                }
+            }
+
+            conditionals.push_back(ConditionalBlock{
+                .parentLive = parentLive,
+                .taken = condition == Condition::True,
+                .maybeTaken = condition == Condition::Unknown,
+                .live = condition != Condition::False,
+                .certain = condition == Condition::True,
+            });
+        } else if (directive == "elif" || directive == "elifdef" || directive == "elifndef") {
+            if (conditionals.empty()) {
+                continue;
+            }
+
+            auto& block = conditionals.back();
+            if (!block.parentLive || block.taken) {
+                block.live = false;
+                block.certain = false;
+                continue;
+            }
+
+            auto condition = Condition::Unknown;
+            if (directive == "elif") {
+                condition = evaluateCondition(rest, macros);
+            } else {
+                auto r = rest;
+                condition = isDefined(takeIdentifier(r), macros);
+                if (directive == "elifndef") {
+                    condition = invert(condition);
+                }
+            }
+
+            block.live = condition != Condition::False;
+            block.certain = condition == Condition::True && !block.maybeTaken;
+            block.taken = condition == Condition::True;
+            block.maybeTaken = block.maybeTaken || condition == Condition::Unknown;
+        } else if (directive == "else") {
+            if (!conditionals.empty()) {
+                auto& block = conditionals.back();
+                block.live = block.parentLive && !block.taken;
+                block.certain = block.live && !block.maybeTaken;
+                block.taken = true;
+            }
+        } else if (directive == "endif") {
+            if (!conditionals.empty()) {
+                conditionals.pop_back();
+            }
+        } else if (!isLive()) {
+            continue;
+        } else if (directive == "define") {
+            auto r = rest;
+            const auto name = takeIdentifier(r);
+            if (name.empty()) {
+                continue;
+            }
+
+            // in a branch that might not be compiled, the macro could be either what it was or this, so it's unknown.
+            // function-like macros are defined, but we can't say what they expand to
+            if (!isCertain()) {
+                macros.erase(std::string{name});
+            } else {
+                macros[std::string{name}] = r.starts_with('(') ? std::string{} : std::string{trim(r)};
+            }
+        } else if (directive == "undef") {
+            auto r = rest;
+            if (!isCertain()) {
+                macros.erase(std::string{takeIdentifier(r)});
+            } else {
+                macros[std::string{takeIdentifier(r)}] = std::nullopt;
+            }
+        } else if (directive == "include" || (isObjC && directive == "import")) {
+            if (rest.size() < 2_uz) {
+                continue;
+            }
+
+            const auto usesQuotes = rest[0] == '"';
+            if (!usesQuotes && rest[0] != '<') {
+                // #include MACRO, nothing we can do with it
+                continue;
+            }
+
+            const auto end = rest.find(usesQuotes ? '"' : '>', 1_uz);
+            if (end == std::string_view::npos) {
+                continue;
+            }
+
+            const auto includedFile = rest.substr(1_uz, end - 1_uz);
+            if (usesQuotes) {
+                COMPDBVS_LOG("Found included file \"{}\"\n", includedFile);
+            } else {
+                COMPDBVS_LOG("Found included file <{}>\n", includedFile);
+            }
+
+            includedFiles.emplace_back(IncludedFile{std::string{includedFile}, usesQuotes});
+        }
+    }
+
+    return includedFiles;
+}
+} // namespace compdbvs::detail
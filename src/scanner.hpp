@@ -0,0 +1,69 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_SCANNER_HPP
+#define COMPDBVS_SCANNER_HPP
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace compdbvs::detail {
+struct IncludedFile
+{
+    std::string filePath;
+    bool usesQuotes;
+};
+
+// what we know about each macro while scanning a file.
+// a value means it's defined (with that replacement text), nullopt means it's definitely not defined,
+// and a macro that isn't in the map at all could be either, since it might come from a header we haven't looked at
+using MacroDefinitions = std::unordered_map<std::string, std::optional<std::string>>;
+
+enum class Condition
+{
+    True,
+    False,
+    Unknown,
+};
+
+// the /D and /U flags in a command, plus what clang-cl predefines when clangd parses it
+[[nodiscard]] auto findDefines(std::string_view command) -> MacroDefinitions;
+
+// evaluates the expression of an #if/#elif, anything we can't work out (function-like macros,
+// macros that weren't defined on the command line etc) gives Unknown rather than guessing
+[[nodiscard]] auto evaluateCondition(std::string_view expression, const MacroDefinitions& macros) -> Condition;
+
+// finds the #include (and #import for Objective-C) directives that the preprocessor would actually see,
+// skipping ones in comments and in #if branches that are known to be dead.
+// branches that can't be evaluated are treated as live
+[[nodiscard]] auto findIncludedFiles(
+    std::span<const std::string> lines,
+    const MacroDefinitions& defines,
+    bool isObjC
+) -> std::vector<IncludedFile>;
+} // namespace compdbvs::detail
+
+#endif // #ifndef COMPDBVS_SCANNER_HPP
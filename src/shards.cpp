@@ -0,0 +1,281 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "shards.hpp"
+#include "paths.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <queue>
+#include <sstream>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace compdbvs {
+[[nodiscard]] auto writeCompileCommandShards(
+    const fs::path& shardDir,
+    std::span<const CompileCommand> compileCommands
+) -> Result<ShardWriteSummary, std::runtime_error>
+{
+    // keep the order the entries came in within each project, so each shard is in the canonical order too
+    std::map<std::string_view, std::vector<CompileCommand>> projects;
+    for (const auto& compileCommand : compileCommands) {
+        projects[compileCommand.project].push_back(compileCommand);
+    }
+
+    ShardWriteSummary summary{
+        .shardCount = projects.size(),
+        .changedShardCount = 0,
+        .removedShardCount = 0,
+    };
+
+    try {
+        fs::create_directories(shardDir);
+
+        std::set<fs::path> shardPaths;
+
+        for (const auto& [project, projectCompileCommands] : projects) {
+            auto shardPath = shardDir / detail::shardFileName(project);
+            const auto stamp = detail::makeShardStamp(projectCompileCommands);
+
+            // the stamp is all that needs reading to know if the shard is up to date
+            std::string existingStamp;
+            if (std::ifstream existing{shardPath, std::ios::binary}; existing && std::getline(existing, existingStamp) && existingStamp == stamp) {
+                COMPDBVS_LOG("Shard {} is up to date\n", shardPath.string());
+                shardPaths.insert(std::move(shardPath));
+                continue;
+            }
+
+            COMPDBVS_LOG("Writing shard {}\n", shardPath.string());
+
+            // only the stamp is read back to decide if a shard can be kept, so a shard that was cut off part way
+            // through (a crash, a full disk) would be trusted forever. it's written to the side and only renamed
+            // into place once all of it has been written
+            const auto written = writeFileAtomically(shardPath, [&] (std::ostream& outStream) -> Result<std::size_t, std::runtime_error> {
+                outStream << stamp << '\n';
+
+                for (const auto& compileCommand : projectCompileCommands) {
+                    outStream << detail::shardSortKey(compileCommand) << '\n';
+                    detail::writeCompileCommandJson(outStream, compileCommand);
+                    outStream << '\n';
+                }
+
+                if (!outStream) {
+                    return std::runtime_error{fmt::format("Failed to write shard {}", shardPath.string())};
+                }
+
+                return projectCompileCommands.size();
+            }, std::ios::binary);
+
+            if (!written) {
+                return written.error();
+            }
+
+            summary.changedShardCount++;
+            shardPaths.insert(std::move(shardPath));
+        }
+
+        // a crash between writing a shard and renaming it leaves the .shard.tmp behind, every shard has been
+        // written by now so any that are left are stale too
+        std::vector<fs::path> staleShards;
+        std::vector<fs::path> staleTempFiles;
+        for (const auto& entry : fs::directory_iterator{shardDir}) {
+            const auto& path = entry.path();
+            if (path.extension() == detail::g_shardExtension && !shardPaths.contains(path)) {
+                staleShards.push_back(path);
+            } else if (path.extension() == ".tmp" && path.stem().extension() == detail::g_shardExtension) {
+                staleTempFiles.push_back(path);
+            }
+        }
+
+        for (const auto& path : staleShards) {
+            COMPDBVS_LOG("Removing shard {}\n", path.string());
+            fs::remove(path);
+            summary.removedShardCount++;
+        }
+
+        for (const auto& path : staleTempFiles) {
+            COMPDBVS_LOG("Removing unfinished shard {}\n", path.string());
+            fs::remove(path);
+        }
+    } catch (const fs::filesystem_error& e) {
+        return std::runtime_error{e.what()};
+    }
+
+    return summary;
+}
+
+[[nodiscard]] auto mergeCompileCommandShards(
+    const fs::path& shardDir,
+    std::ostream& stream
+) -> Result<std::size_t, std::runtime_error>
+{
+    std::vector<fs::path> shardPaths;
+
+    try {
+        for (const auto& entry : fs::directory_iterator{shardDir}) {
+            if (entry.path().extension() == detail::g_shardExtension) {
+                shardPaths.push_back(entry.path());
+            }
+        }
+    } catch (const fs::filesystem_error& e) {
+        return std::runtime_error{e.what()};
+    }
+
+    // directory order isn't guaranteed, and a shard that can't be read should be the same one every time
+    std::ranges::sort(shardPaths);
+
+    // what's left of one shard's entries, each one is its sort key on a line and then its element of the JSON array
+    struct ShardCursor
+    {
+        std::string data;
+        std::size_t pos = 0_uz;
+        std::string_view key;
+        std::string_view entry;
+    };
+
+    // the element always ends with a line that's just the closing brace, the strings in it are escaped so it can't be anywhere else
+    constexpr std::string_view entryEnd = "\n    }\n";
+
+    auto advance = [entryEnd] (ShardCursor& cursor) -> bool {
+        const auto keyEnd = cursor.data.find('\n', cursor.pos);
+        const auto entryEndPos = keyEnd == std::string::npos ? std::string::npos : cursor.data.find(entryEnd, keyEnd);
+        if (entryEndPos == std::string::npos) {
+            return false;
+        }
+
+        const std::string_view data{cursor.data};
+        cursor.key = data.substr(cursor.pos, keyEnd - cursor.pos);
+        cursor.entry = data.substr(keyEnd + 1_uz, entryEndPos + entryEnd.size() - 1_uz - (keyEnd + 1_uz));
+        cursor.pos = entryEndPos + entryEnd.size();
+        return true;
+    };
+
+    std::vector<ShardCursor> cursors;
+    cursors.reserve(shardPaths.size());
+
+    for (const auto& shardPath : shardPaths) {
+        std::ifstream inStream{shardPath, std::ios::binary};
+
+        std::string stamp;
+        if (!std::getline(inStream, stamp)) {
+            return std::runtime_error{fmt::format("Failed to read shard {}", shardPath.string())};
+        }
+
+        // the stamp is "compdb-vs-shard <version> <hash> <entry count>"
+        if (!stamp.starts_with(fmt::format("compdb-vs-shard {} ", detail::g_shardVersion))) {
+            return std::runtime_error{fmt::format("{} is not a compdb-vs shard, or was written by another version", shardPath.string())};
+        }
+
+        auto& cursor = cursors.emplace_back();
+        cursor.data.assign(std::istreambuf_iterator<char>{inStream}, {});
+        if (cursor.data.empty()) {
+            cursors.pop_back();
+        } else if (!advance(cursor)) {
+            return std::runtime_error{fmt::format("Shard {} is truncated", shardPath.string())};
+        }
+    }
+
+    // every shard is already in the canonical order, so taking whichever shard's next entry has the smallest key puts
+    // the whole database back in that order. entries in different shards always differ by project, which is the last
+    // thing in the key, so comparing the keys gives the same order sortCompileCommands does
+    auto isAfter = [&cursors] (std::size_t first, std::size_t second) {
+        return std::tie(cursors[first].key, first) > std::tie(cursors[second].key, second);
+    };
+    std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(isAfter)> next{isAfter};
+    for (auto i = 0_uz; i < cursors.size(); i++) {
+        next.push(i);
+    }
+
+    auto entryCount = 0_uz;
+
+    while (!next.empty()) {
+        const auto index = next.top();
+        next.pop();
+
+        auto& cursor = cursors[index];
+        stream << (entryCount == 0_uz ? "[\n" : ",\n") << cursor.entry;
+        entryCount++;
+
+        if (cursor.pos < cursor.data.size()) {
+            if (!advance(cursor)) {
+                return std::runtime_error{fmt::format("Shard {} is truncated", shardPaths[index].string())};
+            }
+
+            next.push(index);
+        }
+    }
+
+    stream << (entryCount == 0_uz ? "[]" : "\n]");
+    return entryCount;
+}
+
+namespace detail {
+[[nodiscard]] auto hashCompileCommands(std::span<const CompileCommand> compileCommands) -> std::uint64_t
+{
+    auto hash = std::uint64_t{14695981039346656037ull};
+
+    auto hashString = [&hash] (std::string_view string) {
+        for (const auto c : string) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+
+        // so that moving characters from one field to the next changes the hash
+        hash ^= 0xFF;
+        hash *= 1099511628211ull;
+    };
+
+    for (const auto& compileCommand : compileCommands) {
+        hashString(compileCommand.command);
+        hashString(compileCommand.directory);
+        hashString(compileCommand.file);
+        hashString(compileCommand.owner);
+    }
+
+    return hash;
+}
+
+[[nodiscard]] auto shardFileName(std::string_view project) -> std::string
+{
+    // every project's shard has the prefix, so nothing a project can be called gives the name used for no project
+    return project.empty()
+        ? fmt::format("no-project{}", g_shardExtension)
+        : fmt::format("project-{}{}", project, g_shardExtension);
+}
+
+[[nodiscard]] auto makeShardStamp(std::span<const CompileCommand> compileCommands) -> std::string
+{
+    return fmt::format("compdb-vs-shard {} {:016x} {}", g_shardVersion, hashCompileCommands(compileCommands), compileCommands.size());
+}
+
+[[nodiscard]] auto shardSortKey(const CompileCommand& compileCommand) -> std::string
+{
+    // a tab can't be in a Windows path or a project name and sorts before anything that can,
+    // so comparing the joined fields gives the same order as comparing them one by one
+    return fmt::format("{}\t{}\t{}\t{}", foldPath(compileCommand.file), compileCommand.file, compileCommand.owner, compileCommand.project);
+}
+} // namespace detail
+} // namespace compdbvs
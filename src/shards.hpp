@@ -0,0 +1,86 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_SHARDS_HPP
+#define COMPDBVS_SHARDS_HPP
+
+#include "compdb-vs.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace compdbvs {
+// each MSBuild project's entries are kept in their own shard file, which is the project's elements of
+// the JSON array already escaped and formatted, in the canonical order (see sortCompileCommands) and each
+// after a line with its sort key, so the full database can be made by merging them without parsing any JSON.
+// the first line of a shard is a stamp with a hash of its entries, so a shard whose entries haven't changed
+// is recognised without serialising it again
+struct ShardWriteSummary
+{
+    std::size_t shardCount;
+    std::size_t changedShardCount;
+    std::size_t removedShardCount;
+};
+
+// writes <shardDir>/project-<project>.shard for every project in compileCommands, leaving the ones that haven't changed alone,
+// and removes shards for projects that aren't there any more. compileCommands has to be in the order sortCompileCommands gives,
+// or merging the shards won't give that order back
+[[nodiscard]] auto writeCompileCommandShards(
+    const std::filesystem::path& shardDir,
+    std::span<const CompileCommand> compileCommands
+) -> Result<ShardWriteSummary, std::runtime_error>;
+
+// writes every shard in shardDir out as one JSON compilation database, exactly what writeCompileCommandsJson would write
+// for the entries sorted by sortCompileCommands. the entries are copied as they are, nothing is parsed or escaped again.
+// returns the number of entries written
+[[nodiscard]] auto mergeCompileCommandShards(
+    const std::filesystem::path& shardDir,
+    std::ostream& stream
+) -> Result<std::size_t, std::runtime_error>;
+
+namespace detail {
+inline constexpr std::string_view g_shardExtension = ".shard";
+
+// bump this if the layout of a shard ever changes, so old shards get rewritten
+inline constexpr int g_shardVersion = 2;
+
+// FNV-1a over every field that ends up in the JSON
+[[nodiscard]] auto hashCompileCommands(std::span<const CompileCommand> compileCommands) -> std::uint64_t;
+
+// the file in the shard directory that project's entries go in, entries without a project get one of their own
+[[nodiscard]] auto shardFileName(std::string_view project) -> std::string;
+
+// the first line of a shard, changes if the entries or the shard format change
+[[nodiscard]] auto makeShardStamp(std::span<const CompileCommand> compileCommands) -> std::string;
+
+// the line before each entry in a shard. entries in different projects compare the same way by this
+// as they do in sortCompileCommands, so the merge only has to compare keys
+[[nodiscard]] auto shardSortKey(const CompileCommand& compileCommand) -> std::string;
+} // namespace detail
+} // namespace compdbvs
+
+#endif // #ifndef COMPDBVS_SHARDS_HPP
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "trace.hpp"
+#include "compdb-vs.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace compdbvs {
+bool g_tracing = false;
+
+namespace {
+struct TraceEvent
+{
+    const char* name;
+    std::string detail;
+    detail::TraceClock::time_point start;
+    detail::TraceClock::time_point end;
+};
+
+struct ThreadTrace
+{
+    std::size_t threadId;
+    std::vector<TraceEvent> events;
+};
+
+// the buffers are owned here rather than by the threads, so nothing is lost when a worker thread finishes
+std::mutex s_threadTracesMutex;
+std::vector<std::unique_ptr<ThreadTrace>> s_threadTraces;
+detail::TraceClock::time_point s_traceStart;
+// bumped by startTracing so threads know to register a new buffer
+std::atomic<std::size_t> s_traceGeneration = 0;
+
+[[nodiscard]] auto threadTrace() -> ThreadTrace&
+{
+    thread_local ThreadTrace* trace = nullptr;
+    thread_local std::size_t generation = 0;
+
+    if (trace == nullptr || generation != s_traceGeneration) {
+        const std::lock_guard lock{s_threadTracesMutex};
+        trace = s_threadTraces.emplace_back(std::make_unique<ThreadTrace>(s_threadTraces.size() + 1_uz)).get();
+        generation = s_traceGeneration;
+    }
+
+    return *trace;
+}
+} // namespace
+
+namespace detail {
+auto recordTraceEvent(const char* name, std::string detail, TraceClock::time_point start, TraceClock::time_point end) -> void
+{
+    threadTrace().events.push_back(TraceEvent{name, std::move(detail), start, end});
+}
+} // namespace detail
+
+auto startTracing() -> void
+{
+    const std::lock_guard lock{s_threadTracesMutex};
+    s_threadTraces.clear();
+    s_traceGeneration++;
+    s_traceStart = detail::TraceClock::now();
+    g_tracing = true;
+}
+
+auto stopTracing() -> void
+{
+    g_tracing = false;
+}
+
+auto writeTrace(std::ostream& stream) -> void
+{
+    const std::lock_guard lock{s_threadTracesMutex};
+
+    auto microseconds = [] (detail::TraceClock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    };
+
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    auto first = true;
+    auto separate = [&stream, &first] {
+        if (!first) {
+            stream << ",";
+        }
+        stream << "\n";
+        first = false;
+    };
+
+    for (const auto& trace : s_threadTraces) {
+        // metadata so the tracks are labelled, numbered in the order the threads first recorded something
+        separate();
+        stream << fmt::format(
+            R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})",
+            trace->threadId,
+            fmt::format("thread {}", trace->threadId)
+        );
+
+        for (const auto& [name, eventDetail, start, end] : trace->events) {
+            separate();
+            stream << R"({"name":)";
+            detail::writeJsonString(stream, name);
+            stream << fmt::format(
+                R"(,"cat":"compdb-vs","ph":"X","pid":1,"tid":{},"ts":{},"dur":{})",
+                trace->threadId,
+                microseconds(start - s_traceStart),
+                microseconds(end - start)
+            );
+
+            if (!eventDetail.empty()) {
+                stream << R"(,"args":{"detail":)";
+                detail::writeJsonString(stream, eventDetail);
+                stream << "}";
+            }
+
+            stream << "}";
+        }
+    }
+
+    stream << "\n]}\n";
+}
+} // namespace compdbvs
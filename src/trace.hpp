@@ -0,0 +1,116 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_TRACE_HPP
+#define COMPDBVS_TRACE_HPP
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <concepts>
+#include <iosfwd>
+#include <string>
+#include <utility>
+
+// spans of time recorded with these end up in the file given to --trace, in Chrome's trace event format
+// so they can be opened in Perfetto or chrome://tracing. building without COMPDBVS_TRACING (the CMake option
+// of the same name) compiles them out completely, otherwise they cost a check of g_tracing when no trace is being recorded
+#ifdef COMPDBVS_TRACING
+#define COMPDBVS_TRACE_CONCAT_IMPL(a, b) a##b
+#define COMPDBVS_TRACE_CONCAT(a, b) COMPDBVS_TRACE_CONCAT_IMPL(a, b)
+
+#define COMPDBVS_TRACE_SCOPE(name) \
+    const ::compdbvs::TraceScope COMPDBVS_TRACE_CONCAT(compdbvsTraceScope, __LINE__){name}
+
+// like COMPDBVS_TRACE_SCOPE with a detail shown alongside it (the file being read etc),
+// which is only formatted, and its arguments only evaluated, if a trace is being recorded
+#define COMPDBVS_TRACE_SCOPE_DETAIL(name, ...)                                                         \
+    const ::compdbvs::TraceScope COMPDBVS_TRACE_CONCAT(compdbvsTraceScope, __LINE__){                   \
+        name, [&] { return fmt::format(__VA_ARGS__); }                                                  \
+    }
+#else
+#define COMPDBVS_TRACE_SCOPE(name) static_cast<void>(0)
+#define COMPDBVS_TRACE_SCOPE_DETAIL(name, ...) static_cast<void>(0)
+#endif
+
+namespace compdbvs {
+extern bool g_tracing;
+
+namespace detail {
+using TraceClock = std::chrono::steady_clock;
+
+// each thread records into its own buffer, so this doesn't take a lock
+auto recordTraceEvent(const char* name, std::string detail, TraceClock::time_point start, TraceClock::time_point end) -> void;
+} // namespace detail
+
+class TraceScope
+{
+public:
+    // name has to be a string literal, only the pointer is kept
+    explicit TraceScope(const char* name)
+        : m_name{name}
+        , m_active{g_tracing}
+    {
+        if (m_active) {
+            m_start = detail::TraceClock::now();
+        }
+    }
+
+    // makeDetail is only called if a trace is being recorded
+    template<typename TMakeDetail> requires(std::invocable<TMakeDetail&>)
+    TraceScope(const char* name, TMakeDetail&& makeDetail)
+        : TraceScope{name}
+    {
+        if (m_active) {
+            m_detail = std::forward<TMakeDetail>(makeDetail)();
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope(TraceScope&&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+    TraceScope& operator=(TraceScope&&) = delete;
+
+    ~TraceScope()
+    {
+        if (m_active) {
+            detail::recordTraceEvent(m_name, std::move(m_detail), m_start, detail::TraceClock::now());
+        }
+    }
+
+private:
+    const char* m_name;
+    bool m_active;
+    detail::TraceClock::time_point m_start;
+    std::string m_detail;
+};
+
+// throws away anything already recorded and starts recording, timestamps are relative to this call
+auto startTracing() -> void;
+auto stopTracing() -> void;
+
+// writes everything recorded so far as a Chrome trace event JSON object.
+// only call this once the threads doing the work have finished with it
+auto writeTrace(std::ostream& stream) -> void;
+} // namespace compdbvs
+
+#endif // #ifndef COMPDBVS_TRACE_HPP
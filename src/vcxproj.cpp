@@ -0,0 +1,333 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "vcxproj.hpp"
+#include "compdb-vs.hpp"
+#include "flags.hpp"
+#include "paths.hpp"
+#include "xml.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <functional>
+#include <map>
+#include <optional>
+#include <ranges>
+
+namespace compdbvs::detail {
+namespace {
+using Metadata = std::map<std::string, std::string, std::less<>>;
+
+struct ClCompileItem
+{
+    std::string include;
+    Metadata metadata;
+};
+
+// settings that map to a single flag depending on their value
+struct VcxprojSwitch
+{
+    std::string_view name;
+    std::string_view value;
+    std::string_view flag;
+};
+
+constexpr std::array g_vcxprojSwitches = {
+    VcxprojSwitch{"CompileAs", "CompileAsC", "/TC"},
+    VcxprojSwitch{"CompileAs", "CompileAsCpp", "/TP"},
+    VcxprojSwitch{"WarningLevel", "TurnOffAllWarnings", "/W0"},
+    VcxprojSwitch{"WarningLevel", "Level1", "/W1"},
+    VcxprojSwitch{"WarningLevel", "Level2", "/W2"},
+    VcxprojSwitch{"WarningLevel", "Level3", "/W3"},
+    VcxprojSwitch{"WarningLevel", "Level4", "/W4"},
+    VcxprojSwitch{"WarningLevel", "EnableAllWarnings", "/Wall"},
+    VcxprojSwitch{"TreatWarningAsError", "true", "/WX"},
+    VcxprojSwitch{"Optimization", "Disabled", "/Od"},
+    VcxprojSwitch{"Optimization", "MinSpace", "/O1"},
+    VcxprojSwitch{"Optimization", "MaxSpeed", "/O2"},
+    VcxprojSwitch{"Optimization", "Full", "/Ox"},
+    VcxprojSwitch{"RuntimeLibrary", "MultiThreaded", "/MT"},
+    VcxprojSwitch{"RuntimeLibrary", "MultiThreadedDebug", "/MTd"},
+    VcxprojSwitch{"RuntimeLibrary", "MultiThreadedDLL", "/MD"},
+    VcxprojSwitch{"RuntimeLibrary", "MultiThreadedDebugDLL", "/MDd"},
+    VcxprojSwitch{"ExceptionHandling", "Sync", "/EHsc"},
+    VcxprojSwitch{"ExceptionHandling", "SyncCThrow", "/EHs"},
+    VcxprojSwitch{"ExceptionHandling", "Async", "/EHa"},
+    VcxprojSwitch{"RuntimeTypeInfo", "true", "/GR"},
+    VcxprojSwitch{"RuntimeTypeInfo", "false", "/GR-"},
+    VcxprojSwitch{"LanguageStandard", "stdcpp14", "/std:c++14"},
+    VcxprojSwitch{"LanguageStandard", "stdcpp17", "/std:c++17"},
+    VcxprojSwitch{"LanguageStandard", "stdcpp20", "/std:c++20"},
+    VcxprojSwitch{"LanguageStandard", "stdcpplatest", "/std:c++latest"},
+    VcxprojSwitch{"LanguageStandard_C", "stdc11", "/std:c11"},
+    VcxprojSwitch{"LanguageStandard_C", "stdc17", "/std:c17"},
+    VcxprojSwitch{"ConformanceMode", "true", "/permissive-"},
+    VcxprojSwitch{"TreatWChar_tAsBuiltInType", "false", "/Zc:wchar_t-"},
+    VcxprojSwitch{"OpenMPSupport", "true", "/openmp"},
+};
+
+// replaces %(name) in value with what name was before, which is how MSBuild lets an item add to the defaults
+[[nodiscard]] auto expandMetadata(std::string_view value, std::string_view name, std::string_view inherited) -> std::string
+{
+    const auto reference = fmt::format("%({})", name);
+
+    std::string expanded;
+    auto pos = 0_uz;
+    while (true) {
+        const auto found = value.find(reference, pos);
+        expanded.append(value.substr(pos, found == std::string_view::npos ? std::string_view::npos : found - pos));
+        if (found == std::string_view::npos) {
+            break;
+        }
+
+        expanded.append(inherited);
+        pos = found + reference.size();
+    }
+
+    return expanded;
+}
+
+// a ';' separated list, without empty entries or references to metadata we didn't expand
+[[nodiscard]] auto splitList(std::string_view list) -> std::vector<std::string_view>
+{
+    std::vector<std::string_view> entries;
+    for (const auto part : list | std::views::split(';') | std::views::transform([] (const auto s) {
+        return std::string_view{s};
+    })) {
+        auto entry = part;
+        while (!entry.empty() && std::isspace(static_cast<unsigned char>(entry.front()))) {
+            entry.remove_prefix(1_uz);
+        }
+        while (!entry.empty() && std::isspace(static_cast<unsigned char>(entry.back()))) {
+            entry.remove_suffix(1_uz);
+        }
+
+        if (!entry.empty() && !entry.starts_with("%(")) {
+            entries.push_back(entry);
+        }
+    }
+
+    return entries;
+}
+} // namespace
+
+[[nodiscard]] auto vcxprojConditionMatches(std::string_view condition, std::string_view config) -> bool
+{
+    const auto equals = condition.find("=='");
+    if (condition.find("$(Configuration)") == std::string_view::npos || equals == std::string_view::npos) {
+        return true;
+    }
+
+    const auto valueStart = equals + 3_uz;
+    const auto valueEnd = condition.find('\'', valueStart);
+    if (valueEnd == std::string_view::npos) {
+        return true;
+    }
+
+    // '$(Configuration)|$(Platform)'=='Debug|x64', MSBuild compares these case insensitively
+    const auto value = condition.substr(valueStart, valueEnd - valueStart);
+    const auto configuration = value.substr(0_uz, value.find('|'));
+    return std::ranges::equal(configuration, config, [] (const char a, const char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    });
+}
+
+[[nodiscard]] auto readVcxprojCommands(
+    std::string_view document,
+    const std::filesystem::path& projectDirectory,
+    std::string_view config
+) -> Result<std::vector<std::string>, std::runtime_error>
+{
+    // the defaults from ItemDefinitionGroup/ClCompile, and the items from ItemGroup/ClCompile with their own metadata
+    Metadata definitions;
+    std::vector<ClCompileItem> items;
+    std::string characterSet;
+
+    // the names of the elements we're inside of, Project is the first
+    std::vector<std::string_view> elements;
+    // while inside an element whose Condition doesn't apply to config, the depth of that element.
+    // Project is at depth 1, so 0 means nothing is being skipped
+    auto skipDepth = 0_uz;
+    // while inside an ItemGroup/ClCompile, the first of the items its Include made.
+    // Include can list more than one file, and the metadata goes to every one of them
+    auto inItem = false;
+    auto itemStart = 0_uz;
+    std::string text;
+
+    XmlReader reader{document};
+    while (true) {
+        const auto event = reader.next();
+        if (!event) {
+            return event.error();
+        }
+
+        if (event->kind == XmlEventKind::EndOfDocument) {
+            break;
+        }
+
+        switch (event->kind) {
+            case XmlEventKind::StartElement: {
+                elements.push_back(event->name);
+                if (skipDepth != 0_uz) {
+                    break;
+                }
+
+                if (const auto condition = findXmlAttribute(event->text, "Condition")) {
+                    if (!vcxprojConditionMatches(decodeXmlText(*condition), config)) {
+                        skipDepth = elements.size();
+                        break;
+                    }
+                }
+
+                text.clear();
+
+                if (elements.size() == 3_uz && elements[1] == "ItemGroup" && event->name == "ClCompile") {
+                    // <ClCompile Remove="..."/> and friends don't add anything
+                    const auto include = findXmlAttribute(event->text, "Include");
+                    inItem = include.has_value();
+                    itemStart = items.size();
+                    if (include) {
+                        const auto files = decodeXmlText(*include);
+                        for (const auto file : splitList(files)) {
+                            items.push_back(ClCompileItem{.include = std::string{file}, .metadata = {}});
+                        }
+                    }
+                }
+                break;
+            }
+            case XmlEventKind::Text:
+                if (skipDepth == 0_uz && elements.size() >= 3_uz) {
+                    text.append(event->text);
+                }
+                break;
+            case XmlEventKind::EndElement: {
+                if (elements.empty()) {
+                    return std::runtime_error{fmt::format("Unexpected end of element {}", event->name)};
+                }
+
+                if (skipDepth != 0_uz) {
+                    if (elements.size() == skipDepth) {
+                        skipDepth = 0_uz;
+                    }
+                    elements.pop_back();
+                    break;
+                }
+
+                const auto name = std::string{elements.back()};
+                if (elements.size() == 4_uz && elements[2] == "ClCompile") {
+                    if (elements[1] == "ItemDefinitionGroup") {
+                        const auto previous = definitions.find(name);
+                        auto value = expandMetadata(decodeXmlText(text), name, previous == definitions.end() ? "" : previous->second);
+                        definitions.insert_or_assign(name, std::move(value));
+                    } else if (elements[1] == "ItemGroup" && inItem) {
+                        const auto value = decodeXmlText(text);
+                        for (auto i = itemStart; i < items.size(); i++) {
+                            items[i].metadata.insert_or_assign(name, value);
+                        }
+                    }
+                } else if (elements.size() == 3_uz && elements[1] == "PropertyGroup" && name == "CharacterSet") {
+                    characterSet = decodeXmlText(text);
+                } else if (elements.size() == 3_uz && name == "ClCompile") {
+                    inItem = false;
+                }
+
+                elements.pop_back();
+                break;
+            }
+            case XmlEventKind::EndOfDocument:
+                break;
+        }
+    }
+
+    std::vector<std::string> lines;
+    lines.reserve(items.size());
+
+    for (const auto& item : items) {
+        auto get = [&item, &definitions] (std::string_view name) -> std::string {
+            const auto definition = definitions.find(name);
+            const auto inherited = definition == definitions.end() ? std::string_view{} : std::string_view{definition->second};
+            const auto own = item.metadata.find(name);
+            return own == item.metadata.end() ? std::string{inherited} : expandMetadata(own->second, name, inherited);
+        };
+
+        if (get("ExcludedFromBuild") == "true") {
+            continue;
+        }
+
+        std::string line = "/c ";
+
+        const auto includeDirectories = get("AdditionalIncludeDirectories");
+        for (const auto directory : splitList(includeDirectories)) {
+            appendCommandArgument(line, "/I", directory);
+        }
+
+        if (characterSet == "Unicode") {
+            line.append("/D _UNICODE /D UNICODE ");
+        } else if (characterSet == "MultiByte") {
+            line.append("/D _MBCS ");
+        }
+
+        const auto defines = get("PreprocessorDefinitions");
+        for (const auto define : splitList(defines)) {
+            appendCommandArgument(line, "/D ", define);
+        }
+
+        const auto undefines = get("UndefinePreprocessorDefinitions");
+        for (const auto undefine : splitList(undefines)) {
+            appendCommandArgument(line, "/U ", undefine);
+        }
+
+        for (const auto& [name, value, flag] : g_vcxprojSwitches) {
+            if (get(name) == value) {
+                line.append(flag);
+                line.push_back(' ');
+            }
+        }
+
+        const auto disabledWarnings = get("DisableSpecificWarnings");
+        for (const auto warning : splitList(disabledWarnings)) {
+            appendCommandArgument(line, "/wd", warning);
+        }
+
+        const auto forcedIncludes = get("ForcedIncludeFiles");
+        for (const auto include : splitList(forcedIncludes)) {
+            appendCommandArgument(line, "/FI", include);
+        }
+
+        // already a command line, so it goes in as is
+        const auto additionalOptions = get("AdditionalOptions");
+        const auto trimmed = std::string_view{additionalOptions}.substr(0_uz, additionalOptions.find_last_not_of(" \t") + 1_uz);
+        if (!trimmed.empty()) {
+            line.append(trimmed.substr(trimmed.find_first_not_of(" \t")));
+            line.push_back(' ');
+        }
+
+        const auto file = isAbsoluteWindowsPath(item.include) ? std::filesystem::path{item.include} : projectDirectory / item.include;
+        line.append(file.lexically_normal().make_preferred().string());
+
+        lines.push_back(std::move(line));
+    }
+
+    return lines;
+}
+} // namespace compdbvs::detail
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_VCXPROJ_HPP
+#define COMPDBVS_VCXPROJ_HPP
+
+#include "result.hpp"
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace compdbvs::detail {
+// reads the ClCompile items of a .vcxproj and the ClCompile settings that apply to them in the given configuration,
+// and makes the cl.exe command line MSBuild would run for each one, in the same form as the lines of CL.command.1.tlog
+// ("/c <flags> <absolute source file>") so they can go through the same path as the tlog lines.
+// only the settings that change how a file is parsed are turned into flags, anything else is left out
+[[nodiscard]] auto readVcxprojCommands(
+    std::string_view document,
+    const std::filesystem::path& projectDirectory,
+    std::string_view config
+) -> Result<std::vector<std::string>, std::runtime_error>;
+
+// whether an MSBuild Condition such as '$(Configuration)|$(Platform)'=='Debug|x64' applies to config.
+// only the configuration is checked, and anything that doesn't look like a configuration check is assumed to apply
+[[nodiscard]] auto vcxprojConditionMatches(std::string_view condition, std::string_view config) -> bool;
+} // namespace compdbvs::detail
+
+#endif // #ifndef COMPDBVS_VCXPROJ_HPP
@@ -0,0 +1,272 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#include "xml.hpp"
+#include "compdb-vs.hpp"
+
+#include <charconv>
+#include <cctype>
+#include <cstdint>
+
+namespace compdbvs::detail {
+namespace {
+[[nodiscard]] auto isNameEnd(char c) -> bool
+{
+    return std::isspace(static_cast<unsigned char>(c)) || c == '>' || c == '/';
+}
+
+auto appendUtf8(std::string& string, std::uint32_t codePoint) -> void
+{
+    if (codePoint < 0x80) {
+        string.push_back(static_cast<char>(codePoint));
+    } else if (codePoint < 0x800) {
+        string.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        string.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        string.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        string.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        string.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else {
+        string.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        string.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        string.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        string.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+} // namespace
+
+XmlReader::XmlReader(std::string_view document)
+    : m_document{document}
+{
+    // CMake writes a UTF-8 BOM
+    if (m_document.starts_with("\xEF\xBB\xBF")) {
+        m_pos = 3_uz;
+    }
+}
+
+[[nodiscard]] auto XmlReader::next() -> Result<XmlEvent, std::runtime_error>
+{
+    if (m_pendingEnd) {
+        const auto name = *m_pendingEnd;
+        m_pendingEnd.reset();
+        return XmlEvent{.kind = XmlEventKind::EndElement, .name = name};
+    }
+
+    while (m_pos < m_document.size()) {
+        if (m_document[m_pos] != '<') {
+            const auto end = m_document.find('<', m_pos);
+            const auto text = m_document.substr(m_pos, end == std::string_view::npos ? std::string_view::npos : end - m_pos);
+            m_pos = end == std::string_view::npos ? m_document.size() : end;
+            return XmlEvent{.kind = XmlEventKind::Text, .text = text};
+        }
+
+        const auto rest = m_document.substr(m_pos);
+
+        // things that aren't elements, skipped
+        auto skipPast = [this, &rest] (std::string_view start, std::string_view end) -> std::optional<bool> {
+            if (!rest.starts_with(start)) {
+                return std::nullopt;
+            }
+
+            const auto endPos = m_document.find(end, m_pos + start.size());
+            if (endPos == std::string_view::npos) {
+                return false;
+            }
+
+            m_pos = endPos + end.size();
+            return true;
+        };
+
+        if (rest.starts_with("<![CDATA[")) {
+            const auto start = m_pos + 9_uz;
+            const auto end = m_document.find("]]>", start);
+            if (end == std::string_view::npos) {
+                return std::runtime_error{"Unterminated CDATA section"};
+            }
+
+            m_pos = end + 3_uz;
+            return XmlEvent{.kind = XmlEventKind::Text, .text = m_document.substr(start, end - start)};
+        }
+
+        if (const auto skipped = skipPast("<!--", "-->"); skipped) {
+            if (!*skipped) {
+                return std::runtime_error{"Unterminated comment"};
+            }
+            continue;
+        }
+
+        if (const auto skipped = skipPast("<?", "?>"); skipped) {
+            if (!*skipped) {
+                return std::runtime_error{"Unterminated processing instruction"};
+            }
+            continue;
+        }
+
+        if (const auto skipped = skipPast("<!", ">"); skipped) {
+            if (!*skipped) {
+                return std::runtime_error{"Unterminated declaration"};
+            }
+            continue;
+        }
+
+        const auto isEnd = rest.starts_with("</");
+        const auto nameStart = m_pos + (isEnd ? 2_uz : 1_uz);
+        auto nameEnd = nameStart;
+        while (nameEnd < m_document.size() && !isNameEnd(m_document[nameEnd])) {
+            nameEnd++;
+        }
+
+        // the '>' that closes the tag, skipping any inside quoted attribute values
+        auto tagEnd = nameEnd;
+        char quote = 0;
+        while (tagEnd < m_document.size() && (quote != 0 || m_document[tagEnd] != '>')) {
+            const auto c = m_document[tagEnd];
+            if (quote != 0) {
+                if (c == quote) {
+                    quote = 0;
+                }
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            }
+            tagEnd++;
+        }
+
+        if (tagEnd == m_document.size() || nameEnd == nameStart) {
+            return std::runtime_error{fmt::format("Ill formed tag at offset {}", m_pos)};
+        }
+
+        const auto name = m_document.substr(nameStart, nameEnd - nameStart);
+        m_pos = tagEnd + 1_uz;
+
+        if (isEnd) {
+            return XmlEvent{.kind = XmlEventKind::EndElement, .name = name};
+        }
+
+        const auto selfClosing = m_document[tagEnd - 1_uz] == '/';
+        const auto attributesEnd = selfClosing ? tagEnd - 1_uz : tagEnd;
+        if (selfClosing) {
+            m_pendingEnd = name;
+        }
+
+        return XmlEvent{
+            .kind = XmlEventKind::StartElement,
+            .name = name,
+            .text = m_document.substr(nameEnd, attributesEnd - nameEnd),
+        };
+    }
+
+    return XmlEvent{.kind = XmlEventKind::EndOfDocument};
+}
+
+[[nodiscard]] auto findXmlAttribute(std::string_view attributes, std::string_view name) -> std::optional<std::string_view>
+{
+    auto pos = 0_uz;
+    while (pos < attributes.size()) {
+        while (pos < attributes.size() && std::isspace(static_cast<unsigned char>(attributes[pos]))) {
+            pos++;
+        }
+
+        const auto equals = attributes.find('=', pos);
+        if (equals == std::string_view::npos) {
+            return std::nullopt;
+        }
+
+        auto attributeName = attributes.substr(pos, equals - pos);
+        while (!attributeName.empty() && std::isspace(static_cast<unsigned char>(attributeName.back()))) {
+            attributeName.remove_suffix(1_uz);
+        }
+
+        auto valueStart = equals + 1_uz;
+        while (valueStart < attributes.size() && std::isspace(static_cast<unsigned char>(attributes[valueStart]))) {
+            valueStart++;
+        }
+
+        if (valueStart == attributes.size() || (attributes[valueStart] != '"' && attributes[valueStart] != '\'')) {
+            return std::nullopt;
+        }
+
+        const auto valueEnd = attributes.find(attributes[valueStart], valueStart + 1_uz);
+        if (valueEnd == std::string_view::npos) {
+            return std::nullopt;
+        }
+
+        if (attributeName == name) {
+            return attributes.substr(valueStart + 1_uz, valueEnd - valueStart - 1_uz);
+        }
+
+        pos = valueEnd + 1_uz;
+    }
+
+    return std::nullopt;
+}
+
+[[nodiscard]] auto decodeXmlText(std::string_view text) -> std::string
+{
+    std::string decoded;
+    decoded.reserve(text.size());
+
+    auto pos = 0_uz;
+    while (pos < text.size()) {
+        const auto ampersand = text.find('&', pos);
+        decoded.append(text.substr(pos, ampersand == std::string_view::npos ? std::string_view::npos : ampersand - pos));
+        if (ampersand == std::string_view::npos) {
+            break;
+        }
+
+        const auto semicolon = text.find(';', ampersand);
+        if (semicolon == std::string_view::npos) {
+            decoded.append(text.substr(ampersand));
+            break;
+        }
+
+        const auto entity = text.substr(ampersand + 1_uz, semicolon - ampersand - 1_uz);
+        pos = semicolon + 1_uz;
+
+        if (entity == "lt") {
+            decoded.push_back('<');
+        } else if (entity == "gt") {
+            decoded.push_back('>');
+        } else if (entity == "amp") {
+            decoded.push_back('&');
+        } else if (entity == "quot") {
+            decoded.push_back('"');
+        } else if (entity == "apos") {
+            decoded.push_back('\'');
+        } else if (entity.starts_with('#') && entity.size() > 1_uz) {
+            const auto hex = entity[1] == 'x' || entity[1] == 'X';
+            const auto digits = entity.substr(hex ? 2_uz : 1_uz);
+            std::uint32_t codePoint = 0;
+            const auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), codePoint, hex ? 16 : 10);
+            if (error == std::errc{} && end == digits.data() + digits.size()) {
+                appendUtf8(decoded, codePoint);
+            } else {
+                decoded.append(text.substr(ampersand, pos - ampersand));
+            }
+        } else {
+            // not something we know, leave it alone
+            decoded.append(text.substr(ampersand, pos - ampersand));
+        }
+    }
+
+    return decoded;
+}
+} // namespace compdbvs::detail
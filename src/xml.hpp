@@ -0,0 +1,78 @@
+/*
+ * Copyright 2024 Ryan Jeffares
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+ * to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * compdb-vs
+ *
+ * Generate a compilation database based on Visual Studio build files
+*/
+
+#ifndef COMPDBVS_XML_HPP
+#define COMPDBVS_XML_HPP
+
+#include "result.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace compdbvs::detail {
+enum class XmlEventKind
+{
+    StartElement,
+    EndElement,
+    Text,
+    EndOfDocument,
+};
+
+// the views point into the document, and text and attribute values are still escaped (see decodeXmlText)
+struct XmlEvent
+{
+    XmlEventKind kind;
+    // the element name for StartElement and EndElement
+    std::string_view name = {};
+    // the text for Text, everything between the name and the '>' for StartElement
+    std::string_view text = {};
+};
+
+// a pull parser for the subset of XML that MSBuild writes: elements, attributes, text, comments,
+// CDATA, processing instructions and a doctype, which it skips. nothing is copied or allocated,
+// and it doesn't check that end tags match their start tags
+class XmlReader
+{
+public:
+    explicit XmlReader(std::string_view document);
+
+    // a self-closing element gives a StartElement followed by an EndElement
+    [[nodiscard]] auto next() -> Result<XmlEvent, std::runtime_error>;
+
+private:
+    std::string_view m_document;
+    std::size_t m_pos = 0;
+    // the name of a self-closing element whose EndElement hasn't been given yet
+    std::optional<std::string_view> m_pendingEnd;
+};
+
+// finds an attribute in the text of a StartElement, still escaped
+[[nodiscard]] auto findXmlAttribute(std::string_view attributes, std::string_view name) -> std::optional<std::string_view>;
+
+// replaces the five predefined entities and numeric character references
+[[nodiscard]] auto decodeXmlText(std::string_view text) -> std::string;
+} // namespace compdbvs::detail
+
+#endif // #ifndef COMPDBVS_XML_HPP
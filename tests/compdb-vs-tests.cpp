@@ -21,13 +21,45 @@
 */
 
 #include "../src/result.hpp"
+#include "../src/casing-resolver.hpp"
+#include "../src/binary-index.hpp"
+#include "../src/bounded-queue.hpp"
 #include "../src/compdb-vs.hpp"
+#include "../src/file-api.hpp"
+#include "../src/filesystem.hpp"
+#include "../src/flags.hpp"
+#include "../src/memory.hpp"
+#include "../src/path-index.hpp"
+#include "../src/paths.hpp"
+#include "../src/scanner.hpp"
+#include "../src/shards.hpp"
+#include "../src/trace.hpp"
+#include "../src/vcxproj.hpp"
+#include "../src/xml.hpp"
 
 #include <minunit/minunit.h>
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <chrono>
+#include <cctype>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <ranges>
 #include <sstream>
+#include <thread>
 
 namespace compdbvs::tests {
+// the paths the library makes use the platform's separator (C:\Project\src on Windows, C:/Project/src here),
+// so they're compared as paths rather than strings to give the same result everywhere
+[[nodiscard]] static auto isPath(const fs::path& actual, const fs::path& expected) -> bool
+{
+    return actual == expected;
+}
+
 static auto test_Result() -> void
 {
     {
@@ -46,10 +78,168 @@ static auto test_Result() -> void
         mu_check(res);
         mu_check(res->size() == 13_uz);
     }
+
+    {
+        Result<int, Error> res = Error{ErrorCode::NotFound, fs::path{"C:/Foo/bar.h"}};
+        mu_check(res.isErr());
+        mu_check(res.error().code() == ErrorCode::NotFound);
+        mu_check(res.error().context() == fs::path{"C:/Foo/bar.h"});
+        mu_assert_string_eq(res.error().what(), "C:/Foo/bar.h did not exist");
+
+        const auto runtimeError = res.error().toRuntimeError();
+        mu_assert_string_eq(runtimeError.what(), "C:/Foo/bar.h did not exist");
+
+        // a copy formats its own message rather than sharing the one already cached
+        const auto copy = res.error();
+        mu_check(copy.what() != res.error().what());
+        mu_assert_string_eq(copy.what(), "C:/Foo/bar.h did not exist");
+
+        // anything past MAX_PATH keeps the end
+        const auto longPath = fs::path{std::string(300, 'a') + "/bar.h"};
+        const Error error{ErrorCode::NotFound, longPath};
+        mu_check(error.context().filename() == fs::path{"bar.h"});
+        mu_check(error.context().native().size() == 260_uz);
+
+        // and so do our own messages
+        const auto longMessage = std::string(300, 'a') + "tail";
+        const Error messageError{ErrorCode::Filesystem, std::string_view{longMessage}};
+        mu_check(messageError.context().native().size() == 260_uz);
+        mu_check(messageError.context().string().ends_with("aaaatail"));
+        const auto expectedMessage = fmt::format("Filesystem error: {}", longMessage.substr(longMessage.size() - 260));
+        mu_assert_string_eq(messageError.what(), expectedMessage.c_str());
+    }
+}
+
+static auto test_log() -> void
+{
+    auto evaluated = false;
+    auto expensiveArgument = [&evaluated] {
+        evaluated = true;
+        return std::string{"expensive"};
+    };
+
+    const auto verbose = g_verbose;
+
+    g_verbose = false;
+    COMPDBVS_LOG("{}\n", expensiveArgument());
+    mu_check(!evaluated);
+
+    g_verbose = true;
+    COMPDBVS_LOG("{}\n", expensiveArgument());
+    mu_check(evaluated);
+    flushLogs();
+
+    g_verbose = verbose;
+}
+
+static auto test_trace() -> void
+{
+#ifdef COMPDBVS_TRACING
+    auto evaluated = false;
+    auto expensiveArgument = [&evaluated] {
+        evaluated = true;
+        return std::string{"expensive"};
+    };
+
+    {
+        COMPDBVS_TRACE_SCOPE_DETAIL("Not recorded", "{}", expensiveArgument());
+    }
+    mu_check(!evaluated);
+
+    startTracing();
+
+    {
+        COMPDBVS_TRACE_SCOPE_DETAIL("Outer", "{}", "C:\\foo \"bar\".cpp");
+        COMPDBVS_TRACE_SCOPE("Inner");
+    }
+
+    // it's one declaration, so an if without braces guards all of it
+    const auto guarded = !g_tracing;
+    if (guarded)
+        COMPDBVS_TRACE_SCOPE_DETAIL("Guarded", "{}", expensiveArgument());
+    mu_check(!evaluated);
+
+    std::thread{[] {
+        COMPDBVS_TRACE_SCOPE("Worker");
+    }}.join();
+
+    stopTracing();
+
+    {
+        COMPDBVS_TRACE_SCOPE("Not recorded");
+    }
+
+    std::stringstream stream;
+    writeTrace(stream);
+
+    const auto trace = nlohmann::json::parse(stream.str());
+    std::vector<nlohmann::json> spans;
+    std::ranges::copy_if(trace["traceEvents"], std::back_inserter(spans), [] (const auto& event) {
+        return event["ph"] == "X";
+    });
+
+    mu_check(spans.size() == 3_uz);
+    mu_check(spans[0]["name"] == "Inner");
+    mu_check(spans[1]["name"] == "Outer");
+    mu_check(spans[1]["args"]["detail"] == "C:\\foo \"bar\".cpp");
+    mu_check(spans[2]["name"] == "Worker");
+    mu_check(spans[0]["tid"] == spans[1]["tid"]);
+    mu_check(spans[1]["tid"] != spans[2]["tid"]);
+    mu_check(spans[0]["ts"].get<long long>() >= spans[1]["ts"].get<long long>());
+#endif
+}
+
+static auto test_InMemoryFileSystem() -> void
+{
+    InMemoryFileSystem fileSystem;
+    fileSystem.addFile("C:/Project/src/Main.cpp", "int main() {}");
+    fileSystem.addDirectory("C:\\Project\\build\\");
+
+    mu_check(fileSystem.exists("c:/project/SRC/main.CPP"));
+    mu_check(fileSystem.exists("C:/Project/"));
+    mu_check(fileSystem.isDirectory("C:/PROJECT/build"));
+    mu_check(!fileSystem.isDirectory("C:/Project/src/Main.cpp"));
+    mu_check(!fileSystem.exists("C:/Project/src/Other.cpp"));
+
+    const auto entries = fileSystem.listDirectory("C:/project");
+    mu_check(entries);
+    mu_check(entries->size() == 2_uz);
+    mu_check((*entries)[0].path == fs::path{"C:/project/src"});
+    mu_check((*entries)[0].isDirectory);
+    mu_check((*entries)[1].path == fs::path{"C:/project/build"});
+    mu_check(!fileSystem.listDirectory("C:/Project/src/Main.cpp"));
+
+    const auto stream = fileSystem.openFile("C:/PROJECT/SRC/MAIN.CPP");
+    mu_check(stream);
+    const std::string contents{std::istreambuf_iterator<char>{*stream}, {}};
+    mu_check(contents == "int main() {}");
+    mu_check(!fileSystem.openFile("C:/Project/src"));
+
+    const auto stats = fileSystem.stats();
+    mu_check(stats.existsCount == 3);
+    mu_check(stats.isDirectoryCount == 2);
+    mu_check(stats.listDirectoryCount == 2);
+    mu_check(stats.openFileCount == 2);
+
+    fileSystem.resetStats();
+    mu_check(fileSystem.stats().existsCount == 0);
 }
 
 static auto test_getCorrectCasingForPath() -> void
 {
+    {
+        InMemoryFileSystem fileSystem;
+        fileSystem.addFile("C:/Project/src/Main.cpp", {});
+
+        const auto fixed = detail::getCorrectCasingForPath("C:/PROJECT/SRC/main.CPP", fileSystem);
+        mu_check(fixed);
+        mu_check(*fixed == fs::path{"C:/Project/src/Main.cpp"});
+
+        const auto missing = detail::getCorrectCasingForPath("C:/PROJECT/SRC/other.cpp", fileSystem);
+        mu_check(!missing);
+        mu_check(missing.error().code() == ErrorCode::NotFound);
+    }
+
     auto toUpper = [] (std::string& string) -> void {
         for (auto& c : string) {
             c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
@@ -74,6 +264,48 @@ static auto test_getCorrectCasingForPath() -> void
     fs::path doesntExist = "C:/Foo";
     fixed = detail::getCorrectCasingForPath(doesntExist);
     mu_check(fixed.isErr());
+    mu_check(fixed.error().code() == ErrorCode::NotFound);
+}
+
+static auto test_CasingResolver() -> void
+{
+    InMemoryFileSystem fileSystem;
+    fileSystem.addFile("C:/Project/src/main.cpp", "");
+    fileSystem.addFile("C:/Project/src/Util.cpp", "");
+    fileSystem.addFile("C:/Project/include/Lib/lib.hpp", "");
+
+    detail::CasingResolver resolver{fileSystem};
+
+    const std::vector<fs::path> paths = {
+        "C:/PROJECT/SRC/MAIN.CPP",
+        "C:/PROJECT/SRC/UTIL.CPP",
+        "C:/project/include/lib/../lib/LIB.HPP",
+        "C:/PROJECT/SRC/MISSING.CPP",
+        "C:/PROJECT/SRC/MAIN.CPP/NOT_A_DIRECTORY.HPP",
+        "C:/project/src/main.cpp",
+    };
+
+    const auto resolved = resolver.resolve(paths);
+    mu_check(resolved.size() == paths.size());
+    mu_check(resolved[0] && isPath(*resolved[0], "C:/Project/src/main.cpp"));
+    mu_check(resolved[1] && isPath(*resolved[1], "C:/Project/src/Util.cpp"));
+    mu_check(resolved[2] && isPath(*resolved[2], "C:/Project/include/Lib/lib.hpp"));
+    mu_check(!resolved[3] && resolved[3].error().code() == ErrorCode::NotFound);
+    mu_check(!resolved[4] && resolved[4].error().code() == ErrorCode::NotFound);
+    mu_check(resolved[5] && isPath(*resolved[5], "C:/Project/src/main.cpp"));
+
+    // C:, Project, src, include and Lib, once each however many files are under them
+    mu_check(resolver.listingCount() == 5_uz);
+    mu_check(fileSystem.stats().listDirectoryCount == 5);
+
+    // and not again for a later batch
+    const std::vector<fs::path> morePaths = {"C:/PROJECT/SRC/UTIL.CPP"};
+    const auto resolvedAgain = resolver.resolve(morePaths);
+    mu_check(resolvedAgain[0] && isPath(*resolvedAgain[0], "C:/Project/src/Util.cpp"));
+    mu_check(fileSystem.stats().listDirectoryCount == 5);
+
+    const std::vector<fs::path> missingRoot = {"D:/Project/main.cpp"};
+    mu_check(resolver.resolve(missingRoot)[0].error().code() == ErrorCode::NotFound);
 }
 
 static auto test_getFileEncoding() -> void
@@ -141,6 +373,259 @@ static auto test_readFileLines() -> void
     }
 }
 
+static auto test_readFiles() -> void
+{
+    // the byte order mark is dropped and each UTF-16 unit is narrowed, the same as reading through a stream
+    const auto utf16 = detail::readFileLines(std::string_view{"\xFF\xFE/\0c\0\r\0\n\0x\0", 12});
+    mu_check(utf16.size() == 2_uz);
+    mu_check(utf16[0] == "/c");
+    mu_check(utf16[1] == "x");
+
+    // a synthetic tree of small files like a build directory has, read as one batch and one stream at a time
+    const auto treeDir = fs::temp_directory_path() / "compdb-vs-test-read-files";
+    fs::remove_all(treeDir);
+
+    std::vector<fs::path> paths;
+    for (auto i = 0_uz; i < 256_uz; i++) {
+        auto path = treeDir / fmt::format("dir_{}", i % 16_uz) / fmt::format("header_{}.hpp", i);
+        fs::create_directories(path.parent_path());
+        std::ofstream{path, std::ios::binary} << fmt::format("#pragma once\n#include \"header_{}.hpp\"\n", i + 1_uz);
+        paths.push_back(std::move(path));
+    }
+    paths.push_back(treeDir / "missing.hpp");
+
+    RealFileSystem fileSystem;
+
+    const auto contents = fileSystem.readFiles(paths);
+    std::vector<std::vector<std::string>> batchLines;
+    for (const auto& fileContents : contents | std::views::take(256)) {
+        batchLines.push_back(fileContents ? detail::readFileLines(*fileContents) : std::vector<std::string>{});
+    }
+
+    std::vector<std::vector<std::string>> streamLines;
+    for (const auto& path : paths | std::views::take(256)) {
+        const auto stream = fileSystem.openFile(path);
+        auto lines = detail::readFileLines(*stream);
+        streamLines.push_back(lines ? std::move(*lines) : std::vector<std::string>{});
+    }
+
+    mu_check(contents.size() == paths.size());
+    mu_check(!contents.back());
+    mu_check(fileSystem.stats().openFileCount == 2 * 256 + 1);
+
+    mu_check(std::ranges::all_of(contents | std::views::take(256), [] (const auto& fileContents) {
+        return fileContents.has_value();
+    }));
+    mu_check(batchLines == streamLines);
+
+    // batches read from threads that are already running in parallel share the reading threads, and still get everything
+    std::vector<std::vector<std::optional<std::string>>> parallelContents(4);
+    {
+        std::vector<std::jthread> threads;
+        for (auto& threadContents : parallelContents) {
+            threads.emplace_back([&fileSystem, &paths, &threadContents] {
+                threadContents = fileSystem.readFiles(paths);
+            });
+        }
+    }
+    mu_check(std::ranges::all_of(parallelContents, [&contents] (const auto& threadContents) {
+        return threadContents == contents;
+    }));
+
+    fs::remove_all(treeDir);
+
+    // failing to list a directory says which one it was
+    const auto listed = fileSystem.listDirectory(treeDir);
+    mu_check(!listed);
+    mu_check(listed.error().code() == ErrorCode::Filesystem);
+    mu_check(listed.error().context() == treeDir);
+    mu_check(std::string_view{listed.error().what()}.starts_with(fmt::format("Filesystem error on {}: ", treeDir.string())));
+
+    // anything that only knows how to open files gets batches read one at a time
+    InMemoryFileSystem inMemory;
+    inMemory.addFile("C:/a.hpp", "a");
+    inMemory.addDirectory("C:/dir");
+    const std::vector<fs::path> inMemoryPaths{"C:/a.hpp", "C:/dir", "C:/b.hpp"};
+    const auto inMemoryContents = inMemory.readFiles(inMemoryPaths);
+    mu_check(inMemoryContents.size() == 3_uz);
+    mu_check(inMemoryContents[0] == "a");
+    mu_check(!inMemoryContents[1]);
+    mu_check(!inMemoryContents[2]);
+}
+
+// not part of the normal run, run compdb-vs-tests --benchmark to compare the batched reader with opening
+// one stream at a time. the times depend on the disk and the OS's file cache, so only the best of a few rounds is shown
+static auto benchmark_readFiles() -> void
+{
+    const auto treeDir = fs::temp_directory_path() / "compdb-vs-benchmark-read-files";
+    fs::remove_all(treeDir);
+
+    // about what the headers of a big solution look like, lots of small files spread over a lot of directories
+    std::vector<fs::path> paths;
+    for (auto i = 0_uz; i < 4096_uz; i++) {
+        auto path = treeDir / fmt::format("dir_{}", i % 64_uz) / fmt::format("header_{}.hpp", i);
+        fs::create_directories(path.parent_path());
+
+        std::ofstream stream{path, std::ios::binary};
+        stream << "#pragma once\n";
+        for (auto line = 0_uz; line < 64_uz; line++) {
+            stream << fmt::format("#include \"header_{}.hpp\" // line {}\n", (i + line) % 4096_uz, line);
+        }
+        paths.push_back(std::move(path));
+    }
+
+    RealFileSystem fileSystem;
+
+    constexpr auto rounds = 5;
+    auto bestBatch = std::chrono::steady_clock::duration::max();
+    auto bestStream = std::chrono::steady_clock::duration::max();
+    auto lineCount = 0_uz;
+
+    for (auto round = 0; round < rounds; round++) {
+        const auto batchStart = std::chrono::steady_clock::now();
+        for (const auto& fileContents : fileSystem.readFiles(paths)) {
+            lineCount += fileContents ? detail::readFileLines(*fileContents).size() : 0_uz;
+        }
+        bestBatch = std::min(bestBatch, std::chrono::steady_clock::now() - batchStart);
+
+        const auto streamStart = std::chrono::steady_clock::now();
+        for (const auto& path : paths) {
+            const auto stream = fileSystem.openFile(path);
+            const auto lines = detail::readFileLines(*stream);
+            lineCount += lines ? lines->size() : 0_uz;
+        }
+        bestStream = std::min(bestStream, std::chrono::steady_clock::now() - streamStart);
+    }
+
+    fs::remove_all(treeDir);
+
+    logInfo(
+        "Read {} files in {}us as a batch and {}us one stream at a time ({} lines)\n",
+        paths.size(),
+        std::chrono::duration_cast<std::chrono::microseconds>(bestBatch).count(),
+        std::chrono::duration_cast<std::chrono::microseconds>(bestStream).count(),
+        lineCount
+    );
+}
+
+static auto test_allocationStats() -> void
+{
+    mu_check(allocationCountingEnabled());
+
+    const auto before = allocationStats();
+    auto pointer = std::make_unique<std::array<char, 1000>>();
+    const auto during = allocationStats();
+    pointer.reset();
+    const auto after = allocationStats();
+
+    mu_check(during.allocationCount == before.allocationCount + 1);
+    mu_check(during.allocatedBytes >= before.allocatedBytes + 1000);
+    mu_check(during.liveBytes >= before.liveBytes + 1000);
+    mu_check(during.peakLiveBytes >= during.liveBytes);
+    mu_check(after.liveBytes == before.liveBytes);
+
+    // the resident size is measured at each end of the phase, the peak is the OS's one for the whole process
+    const PhaseMeter phase{"resident"};
+    const auto stats = phase.finish();
+#if defined(_WIN32) || defined(__linux__)
+    mu_check(stats.startResidentBytes > 0 && stats.endResidentBytes > 0);
+#endif
+    mu_check(formatPhaseStats(stats).find("process peak RSS") != std::string::npos);
+
+    mu_check(detail::formatBytes(1000) == "1000 B");
+    mu_check(detail::formatBytes(1536) == "1.5 KB");
+    mu_check(detail::formatBytes(3 * 1024 * 1024) == "3.0 MB");
+}
+
+// each hot path is measured on a small input first, and the budget for ten times the input is ten times what that
+// cost with half again on top, since the containers can be at different points of growing for the two sizes. the limits
+// then follow the standard library in use (its small string size, how its containers grow) rather than numbers picked
+// for one of them, and still catch a path starting to grow faster than its input
+[[nodiscard]] static auto withinBaseline(std::uint64_t measured, std::uint64_t baseline, std::uint64_t scale) -> bool
+{
+    const auto budget = baseline * scale;
+    return measured <= budget + budget / 2;
+}
+
+static auto test_memoryBudgets() -> void
+{
+    constexpr auto baselineCount = 100_uz;
+    constexpr auto scale = 10_uz;
+
+    auto makeContents = [] (std::size_t lineCount) {
+        std::string contents;
+        for (auto i = 0_uz; i < lineCount; i++) {
+            contents.append(fmt::format("#include \"some/fairly/long/directory/name/header_{}.hpp\" // and a comment\n", i));
+        }
+        contents.pop_back();
+        return contents;
+    };
+
+    {
+        auto measure = [&makeContents] (std::size_t lineCount) {
+            const auto contents = makeContents(lineCount);
+            std::stringstream stream{contents};
+
+            const PhaseMeter phase{"readFileLines"};
+            const auto lines = detail::readFileLines(stream);
+            return std::pair{phase.finish(), lines ? lines->size() : 0_uz};
+        };
+
+        const auto [baseline, baselineLines] = measure(baselineCount);
+        const auto [stats, lines] = measure(baselineCount * scale);
+        mu_check(baselineLines == baselineCount);
+        mu_check(lines == baselineCount * scale);
+        mu_check(withinBaseline(stats.allocationCount, baseline.allocationCount, scale));
+        mu_check(withinBaseline(stats.peakLiveBytes, baseline.peakLiveBytes, scale));
+    }
+
+    {
+        auto measure = [&makeContents] (std::size_t lineCount) {
+            const auto lines = detail::readFileLines(makeContents(lineCount));
+
+            const PhaseMeter phase{"findIncludedFiles"};
+            const auto includedFiles = detail::findIncludedFiles(lines, {}, false);
+            return std::pair{phase.finish(), includedFiles.size()};
+        };
+
+        const auto [baseline, baselineIncludes] = measure(baselineCount);
+        const auto [stats, includes] = measure(baselineCount * scale);
+        mu_check(baselineIncludes == baselineCount);
+        mu_check(includes == baselineCount * scale);
+        mu_check(withinBaseline(stats.allocationCount, baseline.allocationCount, scale));
+        mu_check(withinBaseline(stats.peakLiveBytes, baseline.peakLiveBytes, scale));
+    }
+
+    {
+        // sources that each include a header of their own and one they all share, so the header scan is part of it too
+        auto measure = [] (std::size_t sourceCount) {
+            InMemoryFileSystem fileSystem;
+            fileSystem.addFile("C:/Project/include/shared.hpp", "#pragma once\n#include <vector>\n");
+
+            std::string tlog;
+            for (auto i = 0_uz; i < sourceCount; i++) {
+                fileSystem.addFile(fmt::format("C:/Project/src/source_{}.cpp", i), fmt::format("#include \"source_{}.hpp\"\n#include <shared.hpp>\n", i));
+                fileSystem.addFile(fmt::format("C:/Project/src/source_{}.hpp", i), "#pragma once\n");
+                tlog.append(fmt::format("^C:/PROJECT/SRC/SOURCE_{0}.CPP\r\n/c /IC:/PROJECT/INCLUDE /Zi /nologo /W3 /Od /D _DEBUG /EHsc /TP C:/PROJECT/SRC/SOURCE_{0}.CPP\r\n", i));
+            }
+            fileSystem.addFile("C:/Project/build/app.dir/Debug/app.tlog/CL.command.1.tlog", tlog);
+
+            const std::vector<fs::path> tlogFiles{"C:/Project/build/app.dir/Debug/app.tlog/CL.command.1.tlog"};
+
+            const PhaseMeter phase{"createCompileCommands"};
+            const auto compileCommands = createCompileCommands("C:/Project/build", tlogFiles, {}, fileSystem);
+            return std::pair{phase.finish(), compileCommands ? compileCommands->size() : 0_uz};
+        };
+
+        const auto [baseline, baselineEntries] = measure(baselineCount);
+        const auto [stats, entries] = measure(baselineCount * scale);
+        mu_check(baselineEntries == 2_uz * baselineCount + 1_uz);
+        mu_check(entries == 2_uz * baselineCount * scale + 1_uz);
+        mu_check(withinBaseline(stats.allocationCount, baseline.allocationCount, scale));
+        mu_check(withinBaseline(stats.peakLiveBytes, baseline.peakLiveBytes, scale));
+    }
+}
+
 static auto test_findIncludePaths() -> void
 {
     using namespace std::string_view_literals;
@@ -174,6 +659,1094 @@ static auto test_findIncludePaths() -> void
     }
 }
 
+static auto test_minimiseCommand() -> void
+{
+    using namespace std::string_view_literals;
+
+    {
+        auto command = "/c /I\"C:\\USERS\\RYAND\\FMT-SRC\\INCLUDE\" /nologo /W1 /WX- /diagnostics:column /O2 /Ob2 /D _MBCS /D \"CMAKE_INTDIR=\\\"Release\\\"\" /Gm- /EHsc /MD /GS /fp:precise /Zc:wchar_t /GR /Fo\"FMT.DIR\\RELEASE\\\\\" /Fd\"C:\\USERS\\RYAND\\RELEASE\\FMT.PDB\" /external:W1 /Gd /TP"sv;
+
+        const auto minimised = detail::minimiseCommand(command);
+        mu_assert_string_eq(
+            "/c /I\"C:\\USERS\\RYAND\\FMT-SRC\\INCLUDE\" /W1 /WX- /O2 /D _MBCS /D \"CMAKE_INTDIR=\\\"Release\\\"\" /EHsc /MD /fp:precise /Zc:wchar_t /GR /TP",
+            minimised.c_str()
+        );
+    }
+
+    {
+        auto command = "/c /external:I \"C:\\Program Files\\SDK\" /external:IC:\\SDK2 /FI\"pch.h\" /Yu\"pch.h\" -Zi /FS"sv;
+
+        const auto minimised = detail::minimiseCommand(command);
+        mu_assert_string_eq("/c /imsvc \"C:\\Program Files\\SDK\" /imsvcC:\\SDK2 /FI\"pch.h\"", minimised.c_str());
+    }
+
+    {
+        mu_check(detail::minimiseCommand("").empty());
+        mu_check(detail::minimiseCommand("   /nologo   ").empty());
+    }
+}
+
+static auto test_compareOwnerCandidates() -> void
+{
+    using namespace std::string_view_literals;
+
+    mu_check(detail::countFlags("cl.exe /c /I \"C:\\foo\" /W4 -Zi C:\\foo\\bar.cpp"sv) == 4_uz);
+    mu_check(detail::countFlags(""sv) == 0_uz);
+
+    const detail::OwnerCandidate small{.sourceIndex = 1_uz, .depth = 1_uz, .sharedPathComponents = 3_uz, .flagCount = 10_uz, .commandLength = 100_uz};
+    const detail::OwnerCandidate unity{.sourceIndex = 0_uz, .depth = 1_uz, .sharedPathComponents = 3_uz, .flagCount = 80_uz, .commandLength = 4000_uz};
+    const detail::OwnerCandidate deeper{.sourceIndex = 2_uz, .depth = 3_uz, .sharedPathComponents = 3_uz, .flagCount = 5_uz, .commandLength = 50_uz};
+    const detail::OwnerCandidate elsewhere{.sourceIndex = 3_uz, .depth = 1_uz, .sharedPathComponents = 1_uz, .flagCount = 5_uz, .commandLength = 50_uz};
+
+    mu_check(detail::compareOwnerCandidates(small, unity));
+    mu_check(!detail::compareOwnerCandidates(unity, small));
+    mu_check(detail::compareOwnerCandidates(small, deeper));
+    mu_check(detail::compareOwnerCandidates(deeper, elsewhere));
+
+    // only the index differs, so the earlier TU wins
+    auto sameAsSmall = small;
+    sameAsSmall.sourceIndex = 5_uz;
+    mu_check(detail::compareOwnerCandidates(small, sameAsSmall));
+    mu_check(!detail::compareOwnerCandidates(small, small));
+}
+
+static auto test_findDefines() -> void
+{
+    using namespace std::string_view_literals;
+
+    const auto defines = detail::findDefines("cl.exe /c /D _MBCS /DWIN32 /D \"CMAKE_INTDIR=\\\"Release\\\"\" /DLEVEL#2 /U NDEBUG /O2 C:\\foo.cpp"sv);
+    mu_check(defines.at("_MBCS") == "1");
+    mu_check(defines.at("WIN32") == "1");
+    mu_check(defines.at("CMAKE_INTDIR") == "\"Release\"");
+    mu_check(defines.at("LEVEL") == "2");
+    mu_check(!defines.at("NDEBUG"));
+    mu_check(!defines.at("__APPLE__"));
+    mu_check(defines.at("_WIN32"));
+    mu_check(!defines.contains("SOMETHING_ELSE"));
+}
+
+static auto test_evaluateCondition() -> void
+{
+    const auto defines = detail::findDefines("cl.exe /c /DFOO=3 /DBAR=FOO /DEMPTY= /U NOPE");
+
+    mu_check(detail::evaluateCondition("0", defines) == detail::Condition::False);
+    mu_check(detail::evaluateCondition("1", defines) == detail::Condition::True);
+    mu_check(detail::evaluateCondition("defined(__APPLE__) || defined __linux__", defines) == detail::Condition::False);
+    mu_check(detail::evaluateCondition("defined(_WIN32) && !defined(NOPE)", defines) == detail::Condition::True);
+    mu_check(detail::evaluateCondition("FOO >= 2 && BAR == 3", defines) == detail::Condition::True);
+    mu_check(detail::evaluateCondition("(FOO + 1) * 2 != 8", defines) == detail::Condition::False);
+    mu_check(detail::evaluateCondition("NOPE", defines) == detail::Condition::False);
+    mu_check(detail::evaluateCondition("0x10 == 16 && 010 == 8 && 1'000 == 1000 && 2u << 1 == 4", defines) == detail::Condition::True);
+    mu_check(detail::evaluateCondition("FOO > 2 ? 1 : 0", defines) == detail::Condition::True);
+
+    // we can't know these, so they have to count as live
+    mu_check(detail::evaluateCondition("UNKNOWN_MACRO", defines) == detail::Condition::Unknown);
+    mu_check(detail::evaluateCondition("_MSC_VER >= 1900", defines) == detail::Condition::Unknown);
+    mu_check(detail::evaluateCondition("EMPTY", defines) == detail::Condition::Unknown);
+    mu_check(detail::evaluateCondition("__has_include(<foo.h>)", defines) == detail::Condition::Unknown);
+    mu_check(detail::evaluateCondition("SOME_VERSION(1, 2) > 3", defines) == detail::Condition::Unknown);
+    mu_check(detail::evaluateCondition("1 +", defines) == detail::Condition::Unknown);
+    mu_check(detail::evaluateCondition("1 / 0", defines) == detail::Condition::Unknown);
+
+    // but an unknown doesn't matter if the other side decides it
+    mu_check(detail::evaluateCondition("UNKNOWN_MACRO || 1", defines) == detail::Condition::True);
+    mu_check(detail::evaluateCondition("0 && UNKNOWN_MACRO", defines) == detail::Condition::False);
+    mu_check(detail::evaluateCondition("defined(__APPLE__) && UNKNOWN_MACRO", defines) == detail::Condition::False);
+}
+
+static auto test_findIncludedFiles() -> void
+{
+    const std::vector<std::string> lines = {
+        "#include \"live.hpp\"",
+        "  #  include <live_spaces.hpp>",
+        "// #include \"line_comment.hpp\"",
+        "/* #include \"block_comment.hpp\"",
+        "#include \"still_comment.hpp\" */ #include \"after_comment.hpp\"",
+        "#if 0",
+        "#include \"if_zero.hpp\"",
+        "#if 1",
+        "#include \"nested_if_zero.hpp\"",
+        "#endif",
+        "#else",
+        "#include \"if_zero_else.hpp\"",
+        "#endif",
+        "#ifdef __APPLE__",
+        "#include <apple.h>",
+        "#elif defined(_WIN32)",
+        "#include <windows.h>",
+        "#else",
+        "#include <unistd.h>",
+        "#endif",
+        "#ifdef CONFIG_FROM_SOME_HEADER",
+        "#include \"unknown_if.hpp\"",
+        "#else",
+        "#include \"unknown_else.hpp\"",
+        "#endif",
+        "#define LOCAL_FLAG 1",
+        "#if LOCAL_FLAG && \\",
+        "    defined(FROM_COMMAND)",
+        "#include \"continued.hpp\"",
+        "#endif",
+        "#undef FROM_COMMAND",
+        "#ifndef FROM_COMMAND",
+        "#include \"undefined_again.hpp\"",
+        "#endif",
+        "#if defined(_MSC_VER) && _MSC_VER >= 1900",
+        "#define HAS_FEATURE 1",
+        "#else",
+        "#define HAS_FEATURE 0",
+        "#endif",
+        "#if HAS_FEATURE",
+        "#include \"maybe_has_feature.hpp\"",
+        "#endif",
+        "#ifdef CONFIG_FROM_SOME_HEADER",
+        "#undef ALSO_FROM_COMMAND",
+        "#endif",
+        "#ifdef ALSO_FROM_COMMAND",
+        "#include \"maybe_undefined.hpp\"",
+        "#endif",
+        "#include MACRO_INCLUDE",
+        "#import \"not_objc.tlb\"",
+    };
+
+    const auto defines = detail::findDefines("cl.exe /c /DFROM_COMMAND /DALSO_FROM_COMMAND C:\\foo.cpp");
+    const auto includedFiles = detail::findIncludedFiles(lines, defines, false);
+
+    const std::vector<std::pair<std::string_view, bool>> expected = {
+        {"live.hpp", true},
+        {"live_spaces.hpp", false},
+        {"after_comment.hpp", true},
+        {"if_zero_else.hpp", true},
+        {"windows.h", false},
+        {"unknown_if.hpp", true},
+        {"unknown_else.hpp", true},
+        {"continued.hpp", true},
+        {"undefined_again.hpp", true},
+        // a #define or #undef in a branch that might not be compiled leaves the macro unknown
+        {"maybe_has_feature.hpp", true},
+        {"maybe_undefined.hpp", true},
+    };
+
+    mu_check(includedFiles.size() == expected.size());
+    for (auto i = 0_uz; i < std::min(includedFiles.size(), expected.size()); i++) {
+        mu_assert_string_eq(expected[i].first.data(), includedFiles[i].filePath.c_str());
+        mu_check(includedFiles[i].usesQuotes == expected[i].second);
+    }
+
+    const std::vector<std::string> objCLines = {"#import <Foundation/Foundation.h>", "#include \"foo.h\""};
+    mu_check(detail::findIncludedFiles(objCLines, defines, true).size() == 2_uz);
+}
+
+static auto test_paths() -> void
+{
+    const auto folded = detail::foldPath("C:\\Users\\Foo\\\\src\\");
+    mu_assert_string_eq("c:/users/foo/src", folded.c_str());
+
+    mu_check(detail::isPathWithin("C:/Users/Foo/src/main.cpp", "c:\\users\\foo"));
+    mu_check(detail::isPathWithin("C:/Users/Foo", "C:/Users/Foo/"));
+    mu_check(detail::isPathWithin("C:/Users/Foo/include/../src/a.h", "C:/Users/Foo/src"));
+    mu_check(!detail::isPathWithin("C:/Users/FooBar/main.cpp", "C:/Users/Foo"));
+    mu_check(!detail::isPathWithin("C:/Users/main.cpp", "C:/Users/Foo"));
+
+    const detail::PathKey upperCase{"C:\\USERS\\FOO\\MAIN.CPP"};
+    mu_check(upperCase == detail::PathKey{"c:/users/foo/main.cpp"});
+    mu_check(std::hash<detail::PathKey>{}(upperCase) == std::hash<detail::PathKey>{}(detail::PathKey{"C:/Users/Foo//Main.cpp"}));
+    mu_check(upperCase != detail::PathKey{"C:/Users/Foo/main.hpp"});
+
+    // long enough to go through the 16 byte loop and then the tail, '@' and '[' sit either side of 'A' to 'Z'
+    mu_check(detail::equalsIgnoreCase("Microsoft.CppCommon.Targets", "MICROSOFT.cppcommon.targets"));
+    mu_check(!detail::equalsIgnoreCase("Microsoft.CppCommon.Targets", "Microsoft.CppCommon.Target"));
+    mu_check(!detail::equalsIgnoreCase("abcdefghijklmnop@", "ABCDEFGHIJKLMNOP`"));
+    mu_check(!detail::equalsIgnoreCase("abcdefghijklmnop[", "ABCDEFGHIJKLMNOP{"));
+    mu_check(!detail::equalsIgnoreCase("\xC0" "bcdefghijklmnopq", "\xE0" "BCDEFGHIJKLMNOPQ"));
+    mu_check(detail::equalsIgnoreCase(L"Documents and Settings", L"DOCUMENTS AND SETTINGS"));
+    mu_check(detail::hashIgnoreCase("Microsoft.CppCommon.Targets") == detail::hashIgnoreCase("MICROSOFT.cppcommon.targets"));
+    mu_check(detail::hashIgnoreCase(L"Main.cpp") == detail::hashIgnoreCase("MAIN.CPP"));
+    mu_check(detail::hashIgnoreCase("main.cpp") != detail::hashIgnoreCase("main.hpp"));
+    mu_check(detail::filenameView(fs::path{"C:/Users/Foo/main.cpp"}) == fs::path{"main.cpp"}.native());
+    mu_check(detail::filenameView(fs::path{"main.cpp"}) == fs::path{"main.cpp"}.native());
+
+    mu_check(detail::isAbsoluteWindowsPath("C:/Users"));
+    mu_check(detail::isAbsoluteWindowsPath("\\\\server\\share"));
+    mu_check(!detail::isAbsoluteWindowsPath("../src/main.cpp"));
+
+    mu_check(detail::matchesGlob("C:\\Dev\\proj\\third_party\\fmt\\core.h", "**/third_party/**"));
+    mu_check(detail::matchesGlob("C:/Dev/proj/src/foo.hpp", "C:/dev/PROJ/**/*.hpp"));
+    mu_check(detail::matchesGlob("C:/Dev/proj/foo.hpp", "C:/Dev/proj/**/*.hpp"));
+    mu_check(detail::matchesGlob("C:/Dev/proj/src/foo.h", "**/src/fo?.h"));
+    mu_check(!detail::matchesGlob("C:/Dev/proj/src/foo.h", "**/src/*.hpp"));
+    mu_check(!detail::matchesGlob("C:/Dev/proj/src/foo.h", "C:/Dev/*.h"));
+    mu_check(!detail::matchesGlob("C:/Dev/proj/src/foo.h", "**/include/**"));
+}
+
+static auto test_findExternalIncludePaths() -> void
+{
+    using namespace std::string_view_literals;
+
+    const auto externalPaths = detail::findExternalIncludePaths(
+        "cl.exe /c /I \"C:\\proj\\include\" /external:I \"C:\\Program Files\\SDK\" /external:IC:\\vcpkg\\include /imsvc C:\\other /external:W0 /external:env:COMPDBVS_TEST_ENV_THAT_DOESNT_EXIST C:\\proj\\main.cpp"sv
+    );
+
+    mu_check(externalPaths.size() == 3_uz);
+    mu_check(externalPaths[0] == fs::path{"C:\\Program Files\\SDK"});
+    mu_check(externalPaths[1] == fs::path{"C:\\vcpkg\\include"});
+    mu_check(externalPaths[2] == fs::path{"C:\\other"});
+
+    mu_check(detail::findExternalIncludePaths("cl.exe /c /I C:\\proj C:\\proj\\main.cpp"sv).empty());
+}
+
+static auto test_BoundedQueue() -> void
+{
+    detail::BoundedQueue<int> queue{4};
+
+    // the producer has to wait for the consumer most of the way, and everything comes out in order
+    std::jthread producer{[&queue] {
+        for (auto i = 0; i < 100; i++) {
+            static_cast<void>(queue.push(i));
+        }
+        queue.close();
+    }};
+
+    auto expected = 0;
+    auto inOrder = true;
+    while (const auto item = queue.pop()) {
+        inOrder = inOrder && *item == expected++;
+    }
+
+    mu_check(inOrder);
+    mu_check(expected == 100);
+    mu_check(!queue.push(100));
+    mu_check(!queue.pop());
+}
+
+static auto test_ConcurrentPathIndex() -> void
+{
+    detail::ConcurrentPathIndex index{4};
+
+    // each thread claims every path, some of them in the opposite order to the others,
+    // whoever has the lowest order has to end up with each path however the threads interleave
+    constexpr auto pathCount = 500;
+    constexpr auto threadCount = 4;
+    {
+        std::vector<std::jthread> threads;
+        for (auto thread = 0; thread < threadCount; thread++) {
+            threads.emplace_back([&index, thread] {
+                for (auto i = 0; i < pathCount; i++) {
+                    const auto path = thread % 2 == 0 ? i : pathCount - 1 - i;
+                    static_cast<void>(index.claim(
+                        detail::PathKey{fmt::format("C:/src/file{}.cpp", path)},
+                        static_cast<std::uint64_t>(thread + path % threadCount)
+                    ));
+                }
+            });
+        }
+    }
+
+    auto allOwned = true;
+    for (auto i = 0; i < pathCount; i++) {
+        allOwned = allOwned && index.owner(detail::PathKey{fmt::format("c:/SRC/FILE{}.CPP", i)}) == i % threadCount;
+    }
+
+    mu_check(allOwned);
+    mu_check(index.size() == static_cast<std::size_t>(pathCount));
+    mu_check(!index.owner(detail::PathKey{"C:/src/other.cpp"}));
+
+    // later claims lose, equal and earlier ones win
+    const detail::PathKey key{"C:/src/file0.cpp"};
+    mu_check(!index.claim(key, 1));
+    mu_check(index.claim(key, 0));
+    mu_check(index.size() == static_cast<std::size_t>(pathCount));
+}
+
+static auto test_CompileCommandStore() -> void
+{
+    StringArena arena;
+    const auto hello = arena.intern("Hello");
+    const auto joined = arena.concat({hello, ", ", "World!"});
+    mu_check(hello == "Hello");
+    mu_check(joined == "Hello, World!");
+    mu_check(arena.intern("").empty());
+    mu_check(arena.bytesUsed() == 18_uz);
+
+    // views have to survive the store being moved
+    CompileCommandStore store;
+    {
+        std::string command = "cl.exe /c C:\\foo.cpp";
+        store.add(CompileCommand{.directory = "C:\\build", .command = command, .file = "C:\\foo.cpp"});
+        command.assign(command.size(), 'x');
+    }
+
+    const auto moved = std::move(store);
+    mu_check(moved.size() == 1_uz);
+    mu_check(moved[0].command == "cl.exe /c C:\\foo.cpp");
+    mu_check(moved[0].directory == "C:\\build");
+    mu_check(moved[0].owner.empty());
+
+    // sorted by path the way Windows compares them, then by the other fields
+    CompileCommandStore unsorted;
+    unsorted.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\src\\b.cpp", .file = "C:\\src\\b.cpp"});
+    unsorted.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\src\\a.hpp", .file = "C:\\src\\a.hpp", .owner = "C:\\src\\b.cpp"});
+    unsorted.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\SRC\\A.cpp", .file = "C:\\SRC\\A.cpp"});
+    unsorted.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\src\\a.hpp", .file = "C:\\src\\a.hpp", .owner = "C:\\SRC\\A.cpp"});
+    const auto sorted = sortCompileCommands(unsorted.commands());
+    mu_check(sorted.size() == 4_uz);
+    mu_check(sorted[0].file == "C:\\SRC\\A.cpp");
+    mu_check(sorted[1].owner == "C:\\SRC\\A.cpp");
+    mu_check(sorted[2].owner == "C:\\src\\b.cpp");
+    mu_check(sorted[3].file == "C:\\src\\b.cpp");
+
+    // and the store is left in the order the entries were made
+    mu_check(unsorted[0].file == "C:\\src\\b.cpp");
+}
+
+static auto test_writeCompileCommandsJson() -> void
+{
+    CompileCommandStore store;
+    store.add(CompileCommand{
+        .directory = "C:\\build",
+        .command = "cl.exe /c /D \"CMAKE_INTDIR=\\\"Debug\\\"\" C:\\src\\foo.cpp",
+        .file = "C:\\src\\foo.cpp",
+    });
+    store.add(CompileCommand{
+        .directory = "C:\\build",
+        .command = "cl.exe /c /D \"TAB=\t\" C:\\src\\foo.hpp",
+        .file = "C:\\src\\foo.hpp",
+        .owner = "C:\\src\\foo.cpp",
+    });
+
+    std::stringstream stream;
+    writeCompileCommandsJson(stream, store.commands());
+
+    auto expected = nlohmann::json::array();
+    for (const auto& [directory, command, file, owner, project] : store) {
+        expected.push_back({
+            {"directory", directory},
+            {"command", command},
+            {"file", file},
+        });
+    }
+
+    std::stringstream expectedStream;
+    expectedStream << std::setw(4) << expected;
+
+    const auto written = stream.str();
+    const auto expectedWritten = expectedStream.str();
+    mu_assert_string_eq(expectedWritten.c_str(), written.c_str());
+    mu_check(nlohmann::json::parse(written) == expected);
+
+    std::stringstream emptyStream;
+    writeCompileCommandsJson(emptyStream, {});
+    mu_check(emptyStream.str() == "[]");
+}
+
+static auto test_shards() -> void
+{
+    mu_check(detail::findProjectName("C:/build/test-lib.dir/Debug/test-lib.tlog/CL.command.1.tlog") == "test-lib");
+
+    CompileCommandStore store;
+    store.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\src\\b.cpp", .file = "C:\\src\\b.cpp", .project = "b"});
+    store.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\src\\a.cpp", .file = "C:\\src\\a.cpp", .project = "a"});
+    store.add(CompileCommand{
+        .directory = "C:\\build",
+        .command = "cl.exe /c C:\\src\\b.hpp",
+        .file = "C:\\src\\b.hpp",
+        .owner = "C:\\src\\b.cpp",
+        .project = "b",
+    });
+
+    const auto shardDir = fs::temp_directory_path() / "compdb-vs-test-shards";
+    fs::remove_all(shardDir);
+
+    const auto sorted = sortCompileCommands(store.commands());
+    auto summary = writeCompileCommandShards(shardDir, sorted);
+    mu_check(summary);
+    mu_check(summary->shardCount == 2_uz);
+    mu_check(summary->changedShardCount == 2_uz);
+
+    // merging gives exactly what writing the whole database would
+    std::stringstream merged;
+    const auto mergedCount = mergeCompileCommandShards(shardDir, merged);
+    mu_check(mergedCount);
+    mu_check(*mergedCount == 3_uz);
+
+    std::stringstream expected;
+    writeCompileCommandsJson(expected, sorted);
+    mu_check(merged.str() == expected.str());
+
+    const auto json = nlohmann::json::parse(merged.str());
+    mu_check(json.size() == 3_uz);
+
+    // nothing changed so nothing is written
+    summary = writeCompileCommandShards(shardDir, sorted);
+    mu_check(summary);
+    mu_check(summary->changedShardCount == 0_uz);
+
+    // only the project that changed is written, and projects that are gone are removed
+    const std::vector<CompileCommand> changed{
+        CompileCommand{.directory = "C:\\build", .command = "cl.exe /c /O2 C:\\src\\a.cpp", .file = "C:\\src\\a.cpp", .project = "a"},
+    };
+    summary = writeCompileCommandShards(shardDir, changed);
+    mu_check(summary);
+    mu_check(summary->changedShardCount == 1_uz);
+    mu_check(summary->removedShardCount == 1_uz);
+
+    std::stringstream mergedChanged;
+    mu_check(mergeCompileCommandShards(shardDir, mergedChanged));
+    std::stringstream expectedChanged;
+    writeCompileCommandsJson(expectedChanged, changed);
+    mu_check(mergedChanged.str() == expectedChanged.str());
+
+    // a project called "_" or "no-project" can't end up in the same shard as the entries that have no project
+    mu_check(detail::shardFileName("") != detail::shardFileName("_"));
+    mu_check(detail::shardFileName("") != detail::shardFileName("no-project"));
+
+    const std::vector<CompileCommand> unnamed{
+        CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\src\\c.cpp", .file = "C:\\src\\c.cpp", .project = "_"},
+        CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\src\\d.cpp", .file = "C:\\src\\d.cpp"},
+    };
+    summary = writeCompileCommandShards(shardDir, unnamed);
+    mu_check(summary);
+    mu_check(summary->shardCount == 2_uz);
+    mu_check(summary->changedShardCount == 2_uz);
+
+    std::stringstream mergedUnnamed;
+    const auto unnamedCount = mergeCompileCommandShards(shardDir, mergedUnnamed);
+    mu_check(unnamedCount);
+    mu_check(*unnamedCount == 2_uz);
+
+    // projects whose files are interleaved, and the same file in more than one project, come out in the same order as without shards
+    CompileCommandStore interleaved;
+    interleaved.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\src\\z.cpp", .file = "C:\\src\\z.cpp", .project = "x"});
+    interleaved.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\src\\B.cpp", .file = "C:\\src\\B.cpp", .project = "x"});
+    interleaved.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\src\\a.cpp", .file = "C:\\src\\a.cpp", .project = "y"});
+    interleaved.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\src\\c.cpp", .file = "C:\\src\\c.cpp", .project = "y"});
+    interleaved.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c /DY C:\\src\\b.hpp", .file = "C:\\src\\b.hpp", .owner = "C:\\src\\c.cpp", .project = "y"});
+    interleaved.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c /DX C:\\src\\b.hpp", .file = "C:\\src\\b.hpp", .owner = "C:\\src\\B.cpp", .project = "x"});
+    interleaved.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:\\src\\a.cpp", .file = "C:\\src\\a.cpp", .project = "x"});
+
+    const auto sortedInterleaved = sortCompileCommands(interleaved.commands());
+    mu_check(writeCompileCommandShards(shardDir, sortedInterleaved));
+
+    std::stringstream mergedInterleaved;
+    mu_check(mergeCompileCommandShards(shardDir, mergedInterleaved));
+    std::stringstream expectedInterleaved;
+    writeCompileCommandsJson(expectedInterleaved, sortedInterleaved);
+    mu_check(mergedInterleaved.str() == expectedInterleaved.str());
+
+    summary = writeCompileCommandShards(shardDir, unnamed);
+    mu_check(summary);
+    mu_check(summary->changedShardCount == 2_uz);
+
+    // a shard that was written but never renamed into place is cleaned up the next time round
+    std::ofstream{shardDir / fmt::format("project-crashed{}.tmp", detail::g_shardExtension)} << "compdb-vs-shard";
+    summary = writeCompileCommandShards(shardDir, unnamed);
+    mu_check(summary);
+    mu_check(summary->changedShardCount == 0_uz);
+    mu_check(summary->removedShardCount == 0_uz);
+
+    // a shard is only ever replaced whole, nothing is left next to it
+    auto onlyShards = true;
+    for (const auto& entry : fs::directory_iterator{shardDir}) {
+        onlyShards = onlyShards && entry.path().extension() == detail::g_shardExtension;
+    }
+    mu_check(onlyShards);
+
+    fs::remove_all(shardDir);
+    std::stringstream mergedEmpty;
+    mu_check(!mergeCompileCommandShards(shardDir, mergedEmpty));
+}
+
+static auto test_writeFileAtomically() -> void
+{
+    const auto outputPath = fs::temp_directory_path() / "compdb-vs-test-atomic.json";
+    auto tempPath = outputPath;
+    tempPath += ".tmp";
+
+    auto writeString = [&outputPath] (std::string_view string) {
+        return writeFileAtomically(outputPath, [string] (std::ostream& stream) -> Result<std::size_t, std::runtime_error> {
+            stream << string;
+            return string.size();
+        });
+    };
+
+    auto readOutput = [&outputPath] () -> std::string {
+        std::ifstream stream{outputPath};
+        return std::string{std::istreambuf_iterator<char>{stream}, std::istreambuf_iterator<char>{}};
+    };
+
+    mu_check(writeString("[]"));
+    mu_check(readOutput() == "[]");
+
+    // replaces what's there
+    const auto written = writeString("[{}]");
+    mu_check(written);
+    mu_check(*written == 4_uz);
+    mu_check(readOutput() == "[{}]");
+
+    // a failed write leaves the old file alone and cleans up after itself
+    const auto failed = writeFileAtomically(outputPath, [] (std::ostream& stream) -> Result<std::size_t, std::runtime_error> {
+        stream << "[";
+        return std::runtime_error{"oops"};
+    });
+    mu_check(!failed);
+    mu_check(readOutput() == "[{}]");
+    mu_check(!fs::exists(tempPath));
+
+    // the same contents again don't touch the file
+    const auto lastWriteTime = fs::last_write_time(outputPath) - std::chrono::hours{1};
+    fs::last_write_time(outputPath, lastWriteTime);
+    mu_check(writeString("[{}]"));
+    mu_check(fs::last_write_time(outputPath) == lastWriteTime);
+    mu_check(!fs::exists(tempPath));
+
+    mu_check(writeString("[{ }]"));
+    mu_check(readOutput() == "[{ }]");
+    mu_check(fs::last_write_time(outputPath) != lastWriteTime);
+
+    fs::remove(outputPath);
+}
+
+static auto test_binaryIndex() -> void
+{
+    CompileCommandStore store;
+    store.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c /DFOO C:\\src\\b.cpp", .file = "C:\\src\\b.cpp"});
+    store.add(CompileCommand{.directory = "C:\\build", .command = "cl.exe /c /DFOO C:\\src\\A.cpp", .file = "C:\\src\\A.cpp"});
+    store.add(CompileCommand{
+        .directory = "C:\\build",
+        .command = "cl.exe /c /D \"TAB=\t\" C:\\src\\c.hpp /Fo\"out\"",
+        .file = "C:\\src\\c.hpp",
+        .owner = "C:\\src\\b.cpp",
+    });
+
+    std::stringstream indexStream;
+    const auto written = writeBinaryIndex(indexStream, store.commands());
+    mu_check(written);
+    mu_check(*written == 3_uz);
+
+    const auto indexData = indexStream.str();
+    const auto bytes = std::as_bytes(std::span{indexData});
+    const auto reader = BinaryIndexReader::open(bytes);
+    mu_check(reader);
+    mu_check(reader->size() == 3_uz);
+
+    // the two source files share one flag set
+    detail::BinaryIndexHeader header;
+    std::memcpy(&header, indexData.data(), sizeof(header));
+    mu_check(header.flagSetCount == 2_uz);
+
+    // everything in the JSON output can be found in the index, whatever the case and separators of the query
+    std::stringstream jsonStream;
+    writeCompileCommandsJson(jsonStream, store.commands());
+    const auto json = nlohmann::json::parse(jsonStream.str());
+    for (const auto& entry : json) {
+        const auto file = entry["file"].get<std::string>();
+        auto query = file;
+        std::ranges::replace(query, '\\', '/');
+        std::ranges::transform(query, query.begin(), [] (char c) { return static_cast<char>(std::toupper(static_cast<unsigned char>(c))); });
+
+        const auto found = reader->find(query);
+        mu_check(found);
+        mu_check(found->file == file);
+        mu_check(found->directory == entry["directory"].get<std::string>());
+        mu_check(found->command() == entry["command"].get<std::string>());
+    }
+
+    mu_check(reader->find("C:/src/b.cpp")->owner.empty());
+    mu_check(reader->find("C:/src/c.hpp")->owner == "C:\\src\\b.cpp");
+    mu_check(!reader->find("C:/src/d.cpp"));
+    mu_check(!reader->find(""));
+
+    // sorted by folded path
+    mu_check((*reader)[0_uz].file == "C:\\src\\A.cpp");
+    mu_check((*reader)[2_uz].file == "C:\\src\\c.hpp");
+
+    mu_check(!BinaryIndexReader::open(bytes.first(sizeof(detail::BinaryIndexHeader) - 1_uz)));
+    mu_check(!BinaryIndexReader::open(bytes.first(bytes.size() - 1_uz)));
+
+    auto badMagic = indexData;
+    badMagic[0] = 'X';
+    mu_check(!BinaryIndexReader::open(std::as_bytes(std::span{badMagic})));
+
+    // a command that spells its file differently (other separators, relative, other case) is stored whole and comes back unchanged
+    const std::vector<CompileCommand> respelled{
+        CompileCommand{.directory = "C:\\build", .command = "cl.exe /c C:/src/e.cpp", .file = "C:\\src\\e.cpp"},
+        CompileCommand{.directory = "C:\\build", .command = "cl.exe /c ..\\SRC\\F.cpp /Fo\"out\"", .file = "C:\\src\\f.cpp"},
+    };
+    std::stringstream respelledStream;
+    mu_check(writeBinaryIndex(respelledStream, respelled));
+
+    const auto respelledData = respelledStream.str();
+    const auto respelledReader = BinaryIndexReader::open(std::as_bytes(std::span{respelledData}));
+    mu_check(respelledReader);
+    for (const auto& compileCommand : respelled) {
+        const auto found = respelledReader->find(compileCommand.file);
+        mu_check(found);
+        mu_check(!found->commandHasFile);
+        mu_check(found->command() == compileCommand.command);
+    }
+
+    // the same thing through a mapped file
+    const auto indexPath = fs::temp_directory_path() / "compdb-vs-test.idx";
+    {
+        std::ofstream indexFile{indexPath, std::ios::binary};
+        indexFile << indexData;
+    }
+
+    {
+        const auto mappedFile = MappedFile::open(indexPath);
+        mu_check(mappedFile);
+        mu_check(mappedFile->bytes().size() == indexData.size());
+
+        const auto mappedReader = BinaryIndexReader::open(mappedFile->bytes());
+        mu_check(mappedReader);
+        const auto found = mappedReader->find("c:\\SRC\\C.HPP");
+        mu_check(found);
+        mu_check(found->command() == store[2].command);
+    }
+
+    fs::remove(indexPath);
+    mu_check(!MappedFile::open(indexPath));
+}
+
+// the whole thing against an in-memory drive, so it runs the same everywhere
+static auto test_inMemoryProgramFlow() -> void
+{
+    InMemoryFileSystem fileSystem;
+    fileSystem.addFile("C:/Project/src/main.cpp", "#include \"main.hpp\"\n#include <lib/lib.hpp>\n#ifdef __APPLE__\n#include <Apple.h>\n#endif\n");
+    fileSystem.addFile("C:/Project/src/main.hpp", "#pragma once\n");
+    fileSystem.addFile("C:/Project/include/lib/lib.hpp", "#pragma once\n#include <vector>\n");
+    fileSystem.addFile(
+        "C:/Project/build/app.dir/Debug/app.tlog/CL.command.1.tlog",
+        "^C:/PROJECT/SRC/MAIN.CPP\r\n/c /IC:/PROJECT/INCLUDE /Zi /nologo /W3 /Od /D _DEBUG /EHsc /TP C:/PROJECT/SRC/MAIN.CPP\r\n"
+    );
+    fileSystem.addFile(
+        "C:/Project/build/app.dir/Release/app.tlog/CL.command.1.tlog",
+        "^C:/PROJECT/SRC/MAIN.CPP\r\n/c /IC:/PROJECT/INCLUDE /O2 /TP C:/PROJECT/SRC/MAIN.CPP\r\n"
+    );
+
+    const auto tlogFiles = findTlogFiles("C:/Project/build", "Debug", fileSystem);
+    mu_check(tlogFiles);
+    mu_check(tlogFiles->size() == 1_uz);
+
+    fileSystem.resetStats();
+
+    const auto compileCommands = createCompileCommands("C:/Project/build", *tlogFiles, {}, fileSystem);
+    mu_check(compileCommands);
+    mu_check(compileCommands->size() == 3_uz);
+
+    const auto& source = (*compileCommands)[0];
+    mu_check(isPath(source.file, "C:/Project/src/main.cpp"));
+    mu_check(source.command == fmt::format("cl.exe /c /IC:/PROJECT/INCLUDE /Zi /nologo /W3 /Od /D _DEBUG /EHsc /TP {}", source.file));
+    mu_check(source.project == "app");
+
+    mu_check(isPath((*compileCommands)[1].file, "C:/Project/src/main.hpp"));
+    mu_check(isPath((*compileCommands)[2].file, "C:/Project/include/lib/lib.hpp"));
+    for (const auto& header : *compileCommands | std::views::drop(1)) {
+        mu_check(header.owner == source.file);
+        mu_check(header.command.ends_with(header.file));
+    }
+
+    // the tlog and each of the three files are only opened once
+    mu_check(fileSystem.stats().openFileCount == 4);
+
+    // making the sources first and adding the headers afterwards gives the same entries
+    auto progressive = createCompileCommands("C:/Project/build", *tlogFiles, {.skipHeaders = true}, fileSystem);
+    mu_check(progressive);
+    mu_check(progressive->size() == 1_uz);
+
+    const auto headerCount = addHeaderCompileCommands(*progressive, {}, fileSystem);
+    mu_check(headerCount);
+    mu_check(*headerCount == 2_uz);
+
+    std::stringstream expected;
+    writeCompileCommandsJson(expected, compileCommands->commands());
+    std::stringstream actual;
+    writeCompileCommandsJson(actual, progressive->commands());
+    mu_check(actual.str() == expected.str());
+
+    // searching the build directory while the tlogs are read gives the same entries too
+    const auto pipelined = createBuildDirCompileCommands("C:/Project/build", BuildInputs::Tlogs, {}, fileSystem);
+    mu_check(pipelined);
+    std::stringstream pipelinedJson;
+    writeCompileCommandsJson(pipelinedJson, pipelined->commands());
+    mu_check(pipelinedJson.str() == expected.str());
+
+    // a tlog that can't be read stops everything
+    const std::vector<fs::path> missingTlogs{*tlogFiles->begin(), "C:/Project/build/lib.dir/Debug/lib.tlog/CL.command.1.tlog"};
+    mu_check(!createCompileCommands("C:/Project/build", missingTlogs, {}, fileSystem));
+}
+
+// an in-memory drive whose tlogs can't be opened without throwing, for the pipeline's worker threads
+class ThrowingTlogFileSystem final : public FileSystem
+{
+public:
+    explicit ThrowingTlogFileSystem(InMemoryFileSystem& fileSystem)
+        : m_fileSystem{fileSystem}
+    {
+
+    }
+
+protected:
+    [[nodiscard]] auto doExists(const fs::path& path) -> bool override
+    {
+        return m_fileSystem.exists(path);
+    }
+
+    [[nodiscard]] auto doIsDirectory(const fs::path& path) -> bool override
+    {
+        return m_fileSystem.isDirectory(path);
+    }
+
+    [[nodiscard]] auto doListDirectory(const fs::path& path) -> Result<std::vector<DirectoryEntry>, Error> override
+    {
+        return m_fileSystem.listDirectory(path);
+    }
+
+    [[nodiscard]] auto doOpenFile(const fs::path& path) -> std::unique_ptr<std::istream> override
+    {
+        if (path.extension() == ".tlog") {
+            throw std::runtime_error{"Couldn't open tlog"};
+        }
+
+        return m_fileSystem.openFile(path);
+    }
+
+private:
+    InMemoryFileSystem& m_fileSystem;
+};
+
+// throwing anywhere in the pipeline gets the exception back to the caller, rather than leaving a stage waiting on a queue
+static auto test_pipelineExceptions() -> void
+{
+    // more projects than can be in flight at once, so the stage finding them is waiting to push when the visitor throws
+    InMemoryFileSystem fileSystem;
+    for (auto i = 0_uz; i < 64_uz; i++) {
+        fileSystem.addFile(fmt::format("C:/Project/src/source_{}.cpp", i), "");
+        fileSystem.addFile(
+            fmt::format("C:/Project/build/project_{0}.dir/Debug/project_{0}.tlog/CL.command.1.tlog", i),
+            fmt::format("^C:/PROJECT/SRC/SOURCE_{0}.CPP\r\n/c /TP C:/PROJECT/SRC/SOURCE_{0}.CPP\r\n", i)
+        );
+    }
+
+    auto visitorThrew = false;
+    try {
+        [[maybe_unused]] const auto visited = visitBuildDirCompileCommands("C:/Project/build", BuildInputs::Tlogs, [] (const CompileCommand&) {
+            throw std::runtime_error{"Visitor failed"};
+        }, {}, fileSystem);
+    } catch (const std::runtime_error& e) {
+        visitorThrew = std::string_view{e.what()} == "Visitor failed";
+    }
+    mu_check(visitorThrew);
+
+    auto workerThrew = false;
+    ThrowingTlogFileSystem throwingFileSystem{fileSystem};
+    try {
+        [[maybe_unused]] const auto created = createBuildDirCompileCommands("C:/Project/build", BuildInputs::Tlogs, {}, throwingFileSystem);
+    } catch (const std::runtime_error& e) {
+        workerThrew = std::string_view{e.what()} == "Couldn't open tlog";
+    }
+    mu_check(workerThrew);
+}
+
+static auto test_headerBudgets() -> void
+{
+    InMemoryFileSystem fileSystem;
+    fileSystem.addFile("C:/Project/src/a.cpp", "#include \"a1.hpp\"\n#include \"shared.hpp\"\n");
+    fileSystem.addFile("C:/Project/src/a1.hpp", "#include \"a2.hpp\"\n");
+    fileSystem.addFile("C:/Project/src/a2.hpp", "#include \"a3.hpp\"\n");
+    fileSystem.addFile("C:/Project/src/a3.hpp", "");
+    fileSystem.addFile("C:/Project/src/shared.hpp", "");
+    fileSystem.addFile("C:/Project/src/b.cpp", "#include \"shared.hpp\"\n#include \"b1.hpp\"\n");
+    fileSystem.addFile("C:/Project/src/b1.hpp", "");
+
+    CompileCommandStore sources;
+    sources.add(CompileCommand{.directory = "C:/Project/build", .command = "cl.exe /c C:/Project/src/a.cpp", .file = "C:/Project/src/a.cpp"});
+    sources.add(CompileCommand{.directory = "C:/Project/build", .command = "cl.exe /c C:/Project/src/b.cpp", .file = "C:/Project/src/b.cpp"});
+
+    auto findHeaders = [&] (const Options& options) -> std::vector<std::string> {
+        std::vector<std::string> headers;
+        const auto headerCount = detail::visitCompileCommandsForHeaders(sources.commands(), [&headers] (const CompileCommand& compileCommand) {
+            headers.emplace_back(compileCommand.file);
+        }, options, fileSystem);
+        return headerCount ? headers : std::vector<std::string>{"failed"};
+    };
+
+    mu_check(findHeaders({}).size() == 5_uz);
+
+    // a2.hpp and a3.hpp are too deep
+    const auto shallow = findHeaders({.maxHeaderDepth = 1_uz});
+    mu_check(shallow.size() == 3_uz);
+    mu_check(isPath(shallow[2], "C:/Project/src/b1.hpp"));
+
+    // b.cpp still reaches shared.hpp, but b1.hpp would be a third entry
+    const auto limited = findHeaders({.maxHeaderEntries = 2_uz});
+    mu_check(limited.size() == 2_uz);
+    mu_check(isPath(limited[0], "C:/Project/src/a1.hpp"));
+    mu_check(isPath(limited[1], "C:/Project/src/shared.hpp"));
+
+    mu_check(findHeaders({.headerTimeBudget = std::chrono::milliseconds{0}}).empty());
+}
+
+static auto test_commandTlogVariants() -> void
+{
+    mu_check(detail::isCommandTlog("CL.command.1.tlog"));
+    mu_check(detail::isCommandTlog("CL.command.2.tlog"));
+    mu_check(detail::isCommandTlog("cl.1234.command.1.tlog"));
+    mu_check(!detail::isCommandTlog("CL.read.1.tlog"));
+    mu_check(!detail::isCommandTlog("link.command.1.tlog"));
+
+    InMemoryFileSystem fileSystem;
+    fileSystem.addFile("C:/Project/src/main.cpp", "");
+    fileSystem.addFile("C:/Project/src/other.cpp", "");
+
+    // added in the order MSBuild would have written them, so the per-process one is newest
+    fileSystem.addFile(
+        "C:/Project/build/app.dir/Debug/app.tlog/CL.command.1.tlog",
+        "^C:/PROJECT/SRC/MAIN.CPP\r\n/c /Od C:/PROJECT/SRC/MAIN.CPP\r\n^C:/PROJECT/SRC/OTHER.CPP\r\n/c /Od C:/PROJECT/SRC/OTHER.CPP\r\n"
+    );
+    fileSystem.addFile("C:/Project/build/app.dir/Debug/app.tlog/CL.read.1.tlog", "^C:/PROJECT/SRC/MAIN.CPP\r\n");
+    fileSystem.addFile(
+        "C:/Project/build/app.dir/Debug/app.tlog/CL.5678.command.1.tlog",
+        "^C:/PROJECT/SRC/MAIN.CPP\r\n/c /O2 C:/PROJECT/SRC/MAIN.CPP\r\n"
+    );
+
+    const auto tlogFiles = findTlogFiles("C:/Project/build", "Debug", fileSystem);
+    mu_check(tlogFiles);
+    mu_check(tlogFiles->size() == 2_uz);
+    mu_check((*tlogFiles)[0].filename() == "CL.command.1.tlog");
+
+    fileSystem.resetStats();
+
+    const auto compileCommands = createCompileCommands("C:/Project/build", *tlogFiles, {.skipHeaders = true}, fileSystem);
+    mu_check(compileCommands);
+    mu_check(compileCommands->size() == 2_uz);
+
+    // main.cpp is in both tlogs, but its casing is only fixed once, and C:/, Project and src are only listed once between both files
+    mu_check(fileSystem.stats().listDirectoryCount == 3);
+    mu_check(isPath((*compileCommands)[0].file, "C:/Project/src/main.cpp"));
+    mu_check((*compileCommands)[0].command == fmt::format("cl.exe /c /O2 {}", (*compileCommands)[0].file));
+    mu_check(isPath((*compileCommands)[1].file, "C:/Project/src/other.cpp"));
+    mu_check((*compileCommands)[1].command == fmt::format("cl.exe /c /Od {}", (*compileCommands)[1].file));
+}
+
+static auto test_xmlReader() -> void
+{
+    detail::XmlReader reader{"\xEF\xBB\xBF<?xml version=\"1.0\"?>\n<!-- a comment -->\n<A x=\"1 &gt; 0\" y='b>c'><B/>t&amp;&#x41;<![CDATA[<raw>]]></A>"};
+
+    // the whitespace between elements isn't interesting here
+    auto next = [&reader] {
+        auto event = reader.next();
+        while (event && event->kind == detail::XmlEventKind::Text && event->text.find_first_not_of(" \n") == std::string_view::npos) {
+            event = reader.next();
+        }
+        return event;
+    };
+
+    auto event = next();
+    mu_check(event && event->kind == detail::XmlEventKind::StartElement && event->name == "A");
+    mu_check(detail::findXmlAttribute(event->text, "x") == "1 &gt; 0");
+    mu_check(detail::findXmlAttribute(event->text, "y") == "b>c");
+    mu_check(!detail::findXmlAttribute(event->text, "z"));
+    mu_check(detail::decodeXmlText(*detail::findXmlAttribute(event->text, "x")) == "1 > 0");
+
+    event = next();
+    mu_check(event && event->kind == detail::XmlEventKind::StartElement && event->name == "B");
+    event = next();
+    mu_check(event && event->kind == detail::XmlEventKind::EndElement && event->name == "B");
+    event = next();
+    mu_check(event && event->kind == detail::XmlEventKind::Text && detail::decodeXmlText(event->text) == "t&A");
+    event = next();
+    mu_check(event && event->kind == detail::XmlEventKind::Text && event->text == "<raw>");
+    event = next();
+    mu_check(event && event->kind == detail::XmlEventKind::EndElement && event->name == "A");
+    event = next();
+    mu_check(event && event->kind == detail::XmlEventKind::EndOfDocument);
+
+    mu_check(!detail::XmlReader{"<A"}.next());
+    mu_check(!detail::XmlReader{"<!-- never closed"}.next());
+
+    mu_check(detail::vcxprojConditionMatches("", "Debug"));
+    mu_check(detail::vcxprojConditionMatches("'$(Configuration)|$(Platform)'=='debug|x64'", "Debug"));
+    mu_check(!detail::vcxprojConditionMatches("'$(Configuration)|$(Platform)'=='Release|x64'", "Debug"));
+    mu_check(detail::vcxprojConditionMatches("'$(Platform)'=='Win32'", "Debug"));
+}
+
+static auto test_vcxprojProgramFlow() -> void
+{
+    InMemoryFileSystem fileSystem;
+    fileSystem.addFile("C:/Project/src/main.cpp", "#include \"main.hpp\"\n");
+    fileSystem.addFile("C:/Project/src/main.hpp", "#pragma once\n");
+    fileSystem.addFile("C:/Project/src/old.cpp", "");
+    fileSystem.addFile("C:/Project/src/util.c", "");
+    fileSystem.addFile(
+        "C:/Project/build/CMakeFiles/3.28.0/CompilerIdCXX/CompilerIdCXX.vcxproj",
+        "<Project><ItemGroup><ClCompile Include=\"CMakeCXXCompilerId.cpp\"/></ItemGroup></Project>"
+    );
+    fileSystem.addFile("C:/Project/build/app.vcxproj", R"(<?xml version="1.0" encoding="UTF-8"?>
+<Project DefaultTargets="Build" ToolsVersion="17.0" xmlns="http://schemas.microsoft.com/developer/msbuild/2003">
+  <PropertyGroup Condition="'$(Configuration)|$(Platform)'=='Debug|x64'" Label="Configuration">
+    <CharacterSet>MultiByte</CharacterSet>
+  </PropertyGroup>
+  <ItemDefinitionGroup Condition="'$(Configuration)|$(Platform)'=='Debug|x64'">
+    <ClCompile>
+      <AdditionalIncludeDirectories>C:/Project/include;C:\Program Files\Lib;%(AdditionalIncludeDirectories)</AdditionalIncludeDirectories>
+      <AdditionalOptions>%(AdditionalOptions) /utf-8</AdditionalOptions>
+      <ExceptionHandling>Sync</ExceptionHandling>
+      <LanguageStandard>stdcpp20</LanguageStandard>
+      <Optimization>Disabled</Optimization>
+      <PreprocessorDefinitions>%(PreprocessorDefinitions);WIN32;_DEBUG;CMAKE_INTDIR="Debug"</PreprocessorDefinitions>
+      <WarningLevel>Level4</WarningLevel>
+    </ClCompile>
+  </ItemDefinitionGroup>
+  <ItemDefinitionGroup Condition="'$(Configuration)|$(Platform)'=='Release|x64'">
+    <ClCompile>
+      <Optimization>MaxSpeed</Optimization>
+    </ClCompile>
+  </ItemDefinitionGroup>
+  <ItemGroup>
+    <ClCompile Include="C:/Project/src/main.cpp" />
+    <ClCompile Include="../src/util.c">
+      <CompileAs>CompileAsC</CompileAs>
+      <PreprocessorDefinitions Condition="'$(Configuration)|$(Platform)'=='Debug|x64'">%(PreprocessorDefinitions);UTIL=1</PreprocessorDefinitions>
+    </ClCompile>
+    <ClCompile Include="C:/Project/src/old.cpp">
+      <ExcludedFromBuild Condition="'$(Configuration)|$(Platform)'=='Debug|x64'">true</ExcludedFromBuild>
+    </ClCompile>
+  </ItemGroup>
+</Project>
+)");
+
+    const auto vcxprojFiles = findVcxprojFiles("C:/Project/build", fileSystem);
+    mu_check(vcxprojFiles);
+    mu_check(vcxprojFiles->size() == 1_uz);
+
+    const auto compileCommands = createCompileCommands("C:/Project/build", *vcxprojFiles, {}, fileSystem);
+    mu_check(compileCommands);
+    mu_check(compileCommands->size() == 3_uz);
+
+    const auto& main = (*compileCommands)[0];
+    mu_check(isPath(main.file, "C:/Project/src/main.cpp"));
+    mu_check(main.project == "app");
+
+    const auto includePaths = detail::findIncludePaths(main.command);
+    mu_check(includePaths);
+    mu_check(includePaths->size() == 2_uz);
+    mu_check((*includePaths)[1] == "C:\\Program Files\\Lib");
+
+    for (const auto flag : {"/D _MBCS", "/D WIN32 /D _DEBUG /D \"CMAKE_INTDIR=\\\"Debug\\\"\"", "/W4", "/Od", "/EHsc", "/std:c++20", "/utf-8"}) {
+        mu_check(main.command.find(flag) != std::string_view::npos);
+    }
+
+    const auto& util = (*compileCommands)[1];
+    mu_check(isPath(util.file, "C:/Project/src/util.c"));
+    mu_check(util.command.find("/D UTIL=1") != std::string_view::npos);
+    mu_check(util.command.find("/TC") != std::string_view::npos);
+
+    mu_check(isPath((*compileCommands)[2].file, "C:/Project/src/main.hpp"));
+    mu_check((*compileCommands)[2].owner == main.file);
+
+    const auto pipelined = createBuildDirCompileCommands("C:/Project/build", BuildInputs::Vcxproj, {}, fileSystem);
+    mu_check(pipelined);
+    mu_check(pipelined->size() == 3_uz);
+    mu_check((*pipelined)[1].command == util.command);
+
+    // an item's metadata goes to every file its Include lists
+    const auto shared = detail::readVcxprojCommands(R"(<Project><ItemGroup>
+    <ClCompile Include="a.cpp;b.cpp"><PreprocessorDefinitions>SHARED=1</PreprocessorDefinitions></ClCompile>
+    <ClCompile Include="c.cpp" />
+</ItemGroup></Project>)", "C:/Project/src", "Debug");
+    mu_check(shared);
+    mu_check(shared->size() == 3_uz);
+    mu_check((*shared)[0].find("/D SHARED=1") != std::string::npos);
+    mu_check((*shared)[1].find("/D SHARED=1") != std::string::npos);
+    mu_check((*shared)[2].find("/D SHARED=1") == std::string::npos);
+}
+
+static auto test_fileApiProgramFlow() -> void
+{
+    InMemoryFileSystem fileSystem;
+    fileSystem.addFile("C:/Project/src/main.cpp", "#include \"main.hpp\"\n");
+    fileSystem.addFile("C:/Project/src/main.hpp", "#pragma once\n");
+    fileSystem.addFile("C:/Project/src/util.c", "");
+
+    const auto createFromReply = [&fileSystem] (std::string_view config) {
+        return createFileApiCompileCommands("C:/Project/build", config, {}, fileSystem);
+    };
+
+    // nothing's there until CMake answers the query
+    mu_check(!createFromReply("Debug"));
+
+    const std::string replyDir = "C:/Project/build/.cmake/api/v1/reply/";
+    fileSystem.addFile(replyDir + "index-2024-01-01T00-00-00-0000.json", R"({"objects": []})");
+    fileSystem.addFile(replyDir + "index-2024-06-01T00-00-00-0000.json", R"({
+        "objects": [{"kind": "codemodel", "version": {"major": 2, "minor": 6}, "jsonFile": "codemodel-v2-1.json"}]
+    })");
+    fileSystem.addFile(replyDir + "codemodel-v2-1.json", R"({
+        "paths": {"source": "C:/Project", "build": "C:/Project/build"},
+        "configurations": [
+            {"name": "Debug", "targets": [{"name": "app", "jsonFile": "target-app-Debug.json"}]},
+            {"name": "Release", "targets": [{"name": "app", "jsonFile": "target-app-Release.json"}]}
+        ]
+    })");
+    fileSystem.addFile(replyDir + "target-app-Debug.json", R"({
+        "name": "app",
+        "sources": [
+            {"path": "src/main.cpp", "compileGroupIndex": 0},
+            {"path": "src/main.hpp"},
+            {"path": "C:/Project/src/util.c", "compileGroupIndex": 1}
+        ],
+        "compileGroups": [
+            {
+                "language": "CXX",
+                "languageStandard": {"standard": "20"},
+                "compileCommandFragments": [{"fragment": "/DWIN32 /W3 /GR /EHsc"}, {"fragment": "/MDd /Od"}],
+                "includes": [{"path": "C:/Project/include"}, {"path": "C:/Program Files/Lib", "isSystem": true}],
+                "defines": [{"define": "CMAKE_INTDIR=\"Debug\""}]
+            },
+            {"language": "C", "compileCommandFragments": [{"fragment": "/W3 /MDd"}]}
+        ]
+    })");
+    fileSystem.addFile(replyDir + "target-app-Release.json", R"({
+        "name": "app",
+        "sources": [{"path": "src/main.cpp", "compileGroupIndex": 0}],
+        "compileGroups": [{"language": "CXX", "compileCommandFragments": [{"fragment": "/O2 /std:c++17"}]}]
+    })");
+
+    fileSystem.resetStats();
+
+    const auto debug = createFromReply("debug");
+    mu_check(debug);
+    mu_check(debug->size() == 3_uz);
+
+    // the sources are written with the platform's separator, like the paths in the tlogs,
+    // but the include paths go into the command exactly as CMake gave them
+    const auto mainCpp = fs::path{"C:/Project/src/main.cpp"}.make_preferred().string();
+    const auto utilC = fs::path{"C:/Project/src/util.c"}.make_preferred().string();
+
+    const auto& main = (*debug)[0];
+    mu_check(main.file == mainCpp);
+    mu_check(main.project == "app");
+    mu_check(main.command == "cl.exe /c /DWIN32 /W3 /GR /EHsc /MDd /Od /std:c++20 /IC:/Project/include /external:I\"C:/Program Files/Lib\" /D\"CMAKE_INTDIR=\\\"Debug\\\"\" " + mainCpp);
+
+    mu_check((*debug)[1].file == utilC);
+    mu_check((*debug)[1].command == "cl.exe /c /W3 /MDd " + utilC);
+    mu_check(isPath((*debug)[2].file, "C:/Project/src/main.hpp"));
+    mu_check((*debug)[2].owner == main.file);
+
+    // the build directory isn't walked and the sources' casing isn't fixed, the only listings are the reply
+    // directory and the three it takes to fix the casing of main.hpp. the reply files and sources are each read once
+    mu_check(fileSystem.stats().listDirectoryCount == 4);
+    mu_check(fileSystem.stats().openFileCount == 6);
+
+    // the other configs come from the same reply
+    const auto release = createFromReply("Release");
+    mu_check(release);
+    mu_check(release->size() == 2_uz);
+    mu_check((*release)[0].command == "cl.exe /c /O2 /std:c++17 " + mainCpp);
+
+    mu_check(!createFromReply("MinSizeRel"));
+}
+
 static auto test_fullProgramFlow() -> void
 {
     {
@@ -182,16 +1755,60 @@ static auto test_fullProgramFlow() -> void
         mu_check(tlogFiles->size() == 4_uz);
 
         {
-            const auto compileCommands = createCompileCommands("build", *tlogFiles, false);
+            const auto compileCommands = createCompileCommands("build", *tlogFiles);
             mu_check(compileCommands);
             mu_check(compileCommands->size() == 7_uz);
+
+            for (const auto& compileCommand : *compileCommands | std::views::drop(5)) {
+                mu_check(!compileCommand.owner.empty());
+                mu_check(compileCommand.command.ends_with(compileCommand.file));
+            }
+
+            // the streaming API sees the same entries in the same order
+            std::vector<std::string> visitedFiles;
+            const auto visitedCount = visitCompileCommands("build", *tlogFiles, [&visitedFiles] (const CompileCommand& compileCommand) {
+                visitedFiles.emplace_back(compileCommand.file);
+            });
+            mu_check(visitedCount);
+            mu_check(*visitedCount == compileCommands->size());
+            mu_check(std::ranges::equal(visitedFiles, *compileCommands, {}, {}, &CompileCommand::file));
         }
 
         {
-            const auto compileCommands = createCompileCommands("build", *tlogFiles, true);
+            const auto compileCommands = createCompileCommands("build", *tlogFiles, {.skipHeaders = true});
             mu_check(compileCommands);
             mu_check(compileCommands->size() == 5_uz);
         }
+
+        {
+            // generous limits for 4 tlogs and 7 entries, these are to catch something going quadratic
+            const PhaseMeter sourcePhase{"createCompileCommands"};
+            const auto sourceCompileCommands = createCompileCommands("build", *tlogFiles, {.skipHeaders = true});
+            const auto sourceStats = sourcePhase.finish();
+            mu_check(sourceCompileCommands);
+            mu_check(sourceStats.allocationCount < 2000);
+            mu_check(sourceStats.peakLiveBytes < 1024 * 1024);
+
+            const PhaseMeter headerPhase{"visitCompileCommandsForHeaders"};
+            const auto headerCount = detail::visitCompileCommandsForHeaders(sourceCompileCommands->commands(), [] (const CompileCommand&) {});
+            const auto headerStats = headerPhase.finish();
+            mu_check(headerCount);
+            mu_check(*headerCount == 2_uz);
+            mu_check(headerStats.allocationCount < 5000);
+            mu_check(headerStats.peakLiveBytes < 2 * 1024 * 1024);
+        }
+
+        {
+            const auto compileCommands = createCompileCommands("build", *tlogFiles, {.skipHeaders = true, .minimalCommands = true});
+            mu_check(compileCommands);
+            mu_check(compileCommands->size() == 5_uz);
+
+            for (const auto& [directory, command, file, owner, project] : *compileCommands) {
+                mu_check(command.starts_with("cl.exe /c"));
+                mu_check(command.ends_with(file));
+                mu_check(command.find("/Fo") == std::string::npos);
+            }
+        }
     }
 
     {
@@ -199,7 +1816,7 @@ static auto test_fullProgramFlow() -> void
         mu_check(tlogFiles);
         mu_check(tlogFiles->empty());
 
-        const auto compileCommands = createCompileCommands("build", *tlogFiles, true);
+        const auto compileCommands = createCompileCommands("build", *tlogFiles, {.skipHeaders = true});
         mu_check(compileCommands);
         mu_check(compileCommands->empty());
     }
@@ -213,16 +1830,49 @@ static auto test_fullProgramFlow() -> void
 MU_TEST_SUITE(testSuite)
 {
     MU_RUN_TEST(test_Result);
+    MU_RUN_TEST(test_log);
+    MU_RUN_TEST(test_trace);
+    MU_RUN_TEST(test_InMemoryFileSystem);
     MU_RUN_TEST(test_getCorrectCasingForPath);
+    MU_RUN_TEST(test_CasingResolver);
     MU_RUN_TEST(test_getFileEncoding);
     MU_RUN_TEST(test_readFileLines);
+    MU_RUN_TEST(test_readFiles);
+    MU_RUN_TEST(test_allocationStats);
+    MU_RUN_TEST(test_memoryBudgets);
     MU_RUN_TEST(test_findIncludePaths);
+    MU_RUN_TEST(test_minimiseCommand);
+    MU_RUN_TEST(test_compareOwnerCandidates);
+    MU_RUN_TEST(test_findDefines);
+    MU_RUN_TEST(test_evaluateCondition);
+    MU_RUN_TEST(test_findIncludedFiles);
+    MU_RUN_TEST(test_paths);
+    MU_RUN_TEST(test_findExternalIncludePaths);
+    MU_RUN_TEST(test_BoundedQueue);
+    MU_RUN_TEST(test_ConcurrentPathIndex);
+    MU_RUN_TEST(test_CompileCommandStore);
+    MU_RUN_TEST(test_writeCompileCommandsJson);
+    MU_RUN_TEST(test_shards);
+    MU_RUN_TEST(test_writeFileAtomically);
+    MU_RUN_TEST(test_binaryIndex);
+    MU_RUN_TEST(test_inMemoryProgramFlow);
+    MU_RUN_TEST(test_pipelineExceptions);
+    MU_RUN_TEST(test_headerBudgets);
+    MU_RUN_TEST(test_commandTlogVariants);
+    MU_RUN_TEST(test_xmlReader);
+    MU_RUN_TEST(test_vcxprojProgramFlow);
+    MU_RUN_TEST(test_fileApiProgramFlow);
     MU_RUN_TEST(test_fullProgramFlow);
 }
 } // namespace compdbvs_tests
 
-auto main([[maybe_unused]] int argc, [[maybe_unused]] const char* argv[]) -> int
+auto main(int argc, const char* argv[]) -> int
 {
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0) {
+        compdbvs::tests::benchmark_readFiles();
+        return 0;
+    }
+
     MU_RUN_SUITE(compdbvs::tests::testSuite);
     MU_REPORT();
 